@@ -69,7 +69,7 @@ typedef struct {
   int vtree_count;          //number of vtrees to be generated
   int initial_ubfs;         //initial ubfs
   int final_ubfs;           //final ubfs
-  int cache_capacity;       //hash table capacity for the vtree
+  int cache_capacity;       //initial hash table capacity for the vtree
 
   //flags
   BOOLEAN in_memory;     //whether or not to save nnf to file
@@ -77,8 +77,62 @@ typedef struct {
   BOOLEAN count_models;  //count the models of the output nnf
   BOOLEAN model_counter; //only (weighted) model counter
   BOOLEAN help;          //help
+
+  int cache_memory;      //memory budget for the vtree cache in megabytes (0 for none)
+  double min_hit_rate;   //percent of lookups below which caching is switched off at a vtree node (0 for never)
+  BOOLEAN hash_keys;     //store fingerprints (128-bit hashes) of keys in the vtree cache
+  int verify_keys;       //check one in verify_keys fingerprint hits against full keys (0 for none)
+  BOOLEAN share_cache;   //share model counts between vtree nodes with the same residual cnf
+  BOOLEAN dynamic;       //count models by dynamic decomposition (without a vtree)
+  BOOLEAN exact;         //count models exactly (with arbitrary precision)
+  char count_type;       //representation of (weighted) model counts: 'd' (double), 'l' (log) or 'e' (extended range)
+  char* weights_filename; //literal weights (one or more weight functions) for (weighted) model counting
+  char* marginals_filename; //output file for the derivatives and marginals of all literals
+  char* queries_filename;   //evidence queries to be answered after counting ("-" for stdin)
+  char* projection_filename; //projection variables for projected (weighted) model counting
+  int jobs;                  //number of processes counting in parallel
+  char* shared_segment;      //shared memory segment holding the component table (option -S)
+  char* cache_filename;      //file from which the vtree cache is loaded, and to which it is saved
+  int checkpoint;            //seconds between saves of the cache file while counting (0 for none)
+  char* learned_filename;    //file from which learned clauses are loaded, and to which they are saved
+  int learned_size;          //largest learned clause saved (0 for no limit)
+  int learned_lbd;           //largest literal block distance of a learned clause saved (0 for no limit)
+  char* nnf_queries_filename; //queries evaluated on the saved Decision-DNNF
+  char* nnf_in_filename;     //Decision-DNNF evaluated instead of compiling the cnf
+  char* nnf_binary_filename; //file to which the smoothed Decision-DNNF is saved in binary
+  char* nnf_text_filename;   //file to which the smoothed Decision-DNNF is saved as text
 } c2dOptions;
 
+/******************************************************************************
+ * Structure for literal weights (see weights.c)
+ ******************************************************************************/
+
+typedef struct {
+  c2dSize var_count; //number of cnf variables
+  c2dSize count;     //number of weight functions
+  c2dWmc* weights;   //weights[(var_count+l)*count+j] is the weight of literal l under function j
+} LiteralWeights;
+
+/******************************************************************************
+ * Structure for a flat nnf (see nnf_eval.c)
+ ******************************************************************************/
+
+//nodes are topologically ordered (children come before their parents) and the root
+//is the last node. the fields of node i follow those of node i-1 in nodes, as varints:
+//the literal of an 'L' node (zigzag encoded), or the decision variable of an 'O' node
+//(0 if none) and the child count of an 'A' or 'O' node, followed by i-c for each child c
+typedef struct {
+  c2dSize var_count;    //number of cnf variables
+  c2dSize node_count;
+  c2dSize edge_count;
+  c2dSize added_count;  //nodes added by smoothing
+  const char* types;    //types[i] is 'L', 'A' or 'O'
+  const BYTE* nodes;
+  c2dSize node_bytes;
+  void* mapping;        //the mapped file holding types and nodes (NULL if they are allocated)
+  c2dSize mapping_size;
+} FlatNnf;
+
 /******************************************************************************
  * Structure clause/variable sets
  ******************************************************************************/
@@ -126,37 +180,300 @@ typedef struct decision_vtree_t {
   struct vtree_cache_entry_t* cache_entry;
 } DVtree;
 
+/******************************************************************************
+ * Structure for parallel counting and compilation (see parallel.c)
+ ******************************************************************************/
+
+//a task counts or compiles a vtree node under a cube (the literals of the Shannon
+//variables above the node)
+typedef struct {
+  DVtree* vtree;      //vtree node of the task
+  c2dLiteral* cube;   //literals assumed true
+  c2dSize size;       //number of literals in cube
+  c2dSize left;       //subtasks (0 if the task is not split, since task 0 is the root)
+  c2dSize right;
+} VtreeTask;
+
+/******************************************************************************
+ * Structures for constructing keys and their hash codes
+ ******************************************************************************/
+
+//the key of a vtree node is gathered from the packed sat state (see sat_api.h)
+//by extracting the bits selected by masks from the words of the packed state
+typedef struct {
+  c2dSize word;       //index of word in packed state
+  unsigned long mask; //bits of word that belong to key
+  c2dSize size;       //number of bits in mask
+} VtreeKeyGather;
+
+typedef struct {
+  c2dSize count;          //number of gathers
+  c2dSize clause_count;   //the first clause_count gathers are from the clause bitset, 
+                          //the rest from the literal bitset
+  VtreeKeyGather* gathers;
+} VtreeKeyMask;
+
+//the hash code of a vtree key is the xor of random words: one word for each
+//subsumed context clause and one for each implied literal of a context variable.
+//these hash codes are maintained incrementally by observing the sat state (see cnf_key.c)
+typedef struct vtree_key_index_t {
+  c2dSize node_count;      //number of vtree nodes (positions)
+  c2dSize clause_count;    //clauses with index < clause_count are indexed
+  c2dSize var_count;       //variables with index < var_count are indexed
+  HASHCODE* clause_words;  //word of each clause (by clause index)
+  HASHCODE* literal_words; //word of each literal (by 2*variable index, +1 for positive literals)
+  //positions of vtree nodes whose context includes clause i are 
+  //clause_nodes[clause_start[i]], ..., clause_nodes[clause_start[i+1]-1]
+  c2dSize* clause_start;
+  c2dSize* clause_nodes;
+  //similarly for the positions of vtree nodes whose context includes variable i
+  c2dSize* var_start;
+  c2dSize* var_nodes;
+  VtreeKeyMask* masks;     //masks[p] is for the key of the vtree node at position p
+} VtreeKeyIndex;
+
+//the incremental hash codes of vtree keys under a given sat state
+typedef struct {
+  VtreeKeyIndex* index;
+  HASHCODE* hashcodes; //hashcodes[p] is for the key of the vtree node at position p
+} VtreeKeyState;
+
+/******************************************************************************
+ * Structures for the nnf nodes made while compiling (see nnf_unique.c)
+ ******************************************************************************/
+
+typedef struct nnf_node_t {
+  c2dSize id;         //nodes are numbered in the order they are made (children first)
+  char type;          //'L', 'A', 'O', '0' (false) or '1' (true)
+  c2dLiteral literal; //literal of an 'L' node, index of the decision variable of an 'O' node
+  struct nnf_node_t* children[2]; //of an 'A' or 'O' node
+} NnfNode;
+
+typedef struct {
+  HASHCODE hashcode;
+  NnfNode* node;      //NULL for an empty slot
+} NnfUniqueSlot;
+
+//the nodes made while compiling, and their unique table (a flat open-addressing table)
+typedef struct {
+  c2dSize var_count;
+  NnfNode* zero;
+  NnfNode* one;
+  NnfNode** literals;         //literals[var_count+l] is the node of literal l
+  NnfNode** blocks;           //nodes are allocated in blocks (see nnf_unique.c)
+  c2dSize block_capacity;
+  c2dSize node_count;
+  NnfUniqueSlot* slots;
+  c2dSize capacity;           //a power of 2
+  int shift;                  //for home slots: 64-log2(capacity)
+  c2dSize count;              //the number of 'A' and 'O' nodes (all in slots or old_slots)
+  NnfUniqueSlot* old_slots;   //slots before the last resize, while they are moved (NULL once moved)
+  c2dSize old_capacity;
+  int old_shift;
+  c2dSize moved;              //old slots before this one have been moved to slots
+  c2dSize lookups;
+  c2dSize hits;
+  c2dSize resizes;
+} UniqueNnf;
+
 /******************************************************************************
  * Structures for vtree cache
  ******************************************************************************/
 
 typedef union vtree_cache_value_t {
   c2dWmc   count; //to cache (weighted) model counts
-  NNF_NODE node;  //to cache nnf nodes
+  NnfNode* node;  //to cache nnf nodes
+  c2dSize  exact; //to cache exact model counts (see count_exact.c)
 } VtreeCV;
  
 typedef struct vtree_cache_entry_t {
-  DVtree* vtree;  //the vtree node that generated this entry
-  BYTE* key;      //a pointer to the starting cell where the key is stored
-  VtreeCV value;  //the value to which the key is mapped
-
-  //a pointer to the next cache entry in the same collision list
-  struct vtree_cache_entry_t* next;
+  DVtree* vtree;     //the vtree node that generated this entry
+  BYTE* key;         //a pointer to the starting cell where the key (or its fingerprint) is stored (in the key arena)
+  VtreeCV value;     //the value to which the key is mapped
+  HASHCODE hashcode; //hash code of the key (identifies the home slot of the entry)
 
-  //keeping track of prev entry in collision list
-  struct vtree_cache_entry_t** prev_next; 
-
-  //a pointer to the next cache entry in the list of cache entries for a given vtree
+  //pointers to the next and previous cache entries in the list of cache entries for 
+  //a given vtree (next is also used to link entries that are free for reuse)
   struct vtree_cache_entry_t* vtree_next;
+  struct vtree_cache_entry_t* vtree_prev;
+
+  BYTE uses;          //recent hits, which protect the entry from eviction (see cache.c)
+  unsigned int epoch; //epoch of its vtree node when the entry was inserted
 } VtreeCE;
 
+//cache activity at a vtree node, used to switch caching off at nodes where it does 
+//not pay off (see cache.c)
+typedef struct {
+  c2dSize hits;   //the number of recent cache hits at the node (halved as lookups accumulate)
+  c2dSize misses; //the number of recent cache misses at the node (halved with hits)
+  BOOLEAN off;    //whether caching has been switched off at the node
+  c2dSize skipped;   //lookups skipped since caching was switched off at the node
+  c2dSize probation; //lookups to skip before caching is switched back on (0 if never switched off)
+  unsigned int epoch; //entries of the node inserted in earlier epochs are stale
+  c2dSize count;  //the number of entries of the node that are not stale
+  HASHCODE evidence; //hash of the evidence on variables of the node when its entries were computed (0 for none)
+} VtreeCN;
+
+//a slot of the open-addressing table: the hash code is kept inline so that
+//probing does not need to touch entries whose hash codes differ
+typedef struct {
+  HASHCODE hashcode; //hash code of the entry key
+  VtreeCE* entry;    //NULL if the slot is empty
+} VtreeCS;
+
+//cache entries and keys are allocated in blocks (see cache.c)
+typedef struct vtree_cache_block_t {
+  struct vtree_cache_block_t* next;
+  c2dSize size; //number of bytes in block
+  c2dSize used; //number of bytes used in block
+  BYTE cells[];
+} VtreeCB;
+
+//an entry of the component table, which maps residual cnfs to model counts (see component.c)
+typedef struct {
+  c2dSize* key;       //NULL if the slot is empty
+  c2dSize size;       //number of indices in key
+  HASHCODE hashcode;  //hash code of the key
+  c2dWmc count;       //count divided by the weights of the assigned variables of vtree node
+  c2dSize position;   //position of the vtree node that computed the count
+  unsigned int epoch; //epoch of that vtree node when the entry was inserted
+} ComponentCE;
+
+//a slot of the component table shared by parallel jobs (see component.c): a job claims
+//an empty slot before writing its entry, and publishes the entry once it is complete
+typedef struct {
+  unsigned int state; //SHARED_EMPTY, SHARED_WRITING or SHARED_READY
+  c2dSize size;       //number of indices in key
+  HASHCODE hashcode;  //hash code of the key
+  c2dWmc count;       //count divided by the weights of the assigned variables of vtree node
+  c2dSize key;        //offset of the key in the key arena
+} SharedComponentCS;
+
+//activity of one job on the shared component table (merged when printed)
+typedef struct {
+  c2dSize hits;
+  c2dSize misses;
+  c2dSize drops;      //inserts dropped as the table or its key arena is full
+} SharedComponentStats;
+
+//the shared component table is one block of shared memory, which may be mapped at
+//different addresses by different processes: its parts are given by offsets into the block
+typedef struct {
+  unsigned long magic; //SHARED_MAGIC once the block is initialized
+  HASHCODE cnf;        //fingerprint of the cnf whose components are in the table
+  c2dSize bytes;       //size of the block
+  c2dSize capacity;    //the total number of slots (a power of 2)
+  c2dSize shift;       //64-log2(capacity): maps hash codes to home slots
+  c2dSize slots;       //offset of the slots (SharedComponentCS)
+  c2dSize count;       //the number of entries (updated atomically)
+  c2dSize keys;        //offset of the key arena (c2dSize cells)
+  c2dSize key_capacity;
+  c2dSize key_used;    //cells of the key arena reserved by jobs (updated atomically)
+  c2dSize stats;       //offset of the stats of jobs (SharedComponentStats)
+  c2dSize stats_capacity;
+  c2dSize stats_used;  //stats claimed by processes (updated atomically)
+} SharedComponentCache;
+
+typedef struct {
+  c2dSize capacity;    //the total number of slots (a power of 2)
+  c2dSize shift;       //64-log2(capacity): maps hash codes to home slots
+  ComponentCE* slots;
+  c2dSize count;       //the number of entries
+  c2dSize memory;      //the memory (in bytes) used to store keys
+  c2dSize hits;        //the number of hits
+  c2dSize shared_hits; //the number of hits on entries computed at another vtree node
+  c2dSize misses;      //the number of misses
+  c2dSize decisions;   //the number of decisions (when counting by dynamic decomposition)
+  //the key of the last vtree node whose residual cnf was identified
+  c2dSize* key;
+  c2dSize size;
+  c2dSize key_capacity;
+  HASHCODE hashcode;
+  c2dWmc weight;       //weight of the assigned variables of that vtree node
+  //when jobs count in parallel, or processes share a segment, the shared table is used instead of slots
+  SharedComponentCache* shared;
+  c2dSize first_stats; //the stats of job j of this process are stats first_stats+j of the shared table
+  c2dSize job_count;   //the number of jobs of this process
+  c2dSize job;         //the job using this (copy of the) cache
+} ComponentCache;
+
+//a count loaded from a cache file (see cache_file.c)
+typedef struct {
+  HASHCODE hashcode; //hash code of the key (0 with node 0 for an empty slot)
+  c2dSize node;      //position+1 of the vtree node of the entry (0 for an empty slot)
+  c2dWmc count;
+  c2dSize key;       //offset of the key (or fingerprint) in the key cells
+} SavedCE;
+
 typedef struct {
-  c2dSize capacity;  //the total number of buckets (collision lists) in cache
-  VtreeCE** buckets; //the array where cache buckets are stored
+  const char* fname;   //the cache file
+  c2dSize capacity;    //the total number of slots (a power of 2)
+  c2dSize shift;       //64-log2(capacity): maps hash codes to home slots
+  SavedCE* slots;
+  c2dSize count;       //the number of entries
+  BYTE* keys;          //keys of entries, as stored in vtree cache entries
+  c2dSize key_bytes;
+  c2dSize hits;        //the number of hits
+  c2dSize checkpoints; //the number of times the cache file was saved while counting
+} SavedCache;
+
+//returns the bytes of the arena of counts used by a cached count (0 if it is stored
+//in its entry), after moving it to new cells if move (see cache.c)
+struct vtree_cache_t;
+typedef c2dSize (*VtreeCountCells)(VtreeCV* value, BOOLEAN move, struct vtree_cache_t* cache);
+
+typedef struct vtree_cache_t {
+  c2dSize capacity;  //the total number of slots in cache (a power of 2)
+  c2dSize shift;     //64-log2(capacity): maps hash codes to home slots
+  VtreeCS* slots;    //the array where cache slots are stored
   c2dSize count;     //the number of entries currently in cache
   c2dSize memory;    //the memory (in bytes) used to store cache entries
   c2dSize hits;      //the number of cache hits
   c2dSize misses;    //the number of cache misses
+  c2dSize resizes;   //the number of times the slot array has grown
+
+  //memory budget
+  c2dSize limit;      //the memory (in bytes) that cache may use (0 for no limit)
+  c2dSize evictions;  //the number of entries evicted to stay within limit
+  c2dSize clock_hand; //the slot where the next search for an entry to evict starts
+
+  //adaptive caching
+  VtreeCN* nodes;     //nodes[p] is the cache activity at the vtree node with position p
+  c2dSize node_count; //the number of vtree nodes
+  c2dSize nodes_off;  //the number of vtree nodes where caching is switched off
+  c2dSize switches;   //the number of times caching was switched off or on at a vtree node
+  double min_hit_rate; //caching is switched off at vtree nodes with a lower hit rate (0 for never)
+
+  //invalidation
+  c2dSize stale;  //the number of entries in cache that are stale (to be dropped lazily)
+  c2dSize sweeps; //the number of times stale entries were swept from cache
+
+  //fingerprints: entries store 128-bit hashes of their keys instead of the keys 
+  //(followed by the keys when a sample of fingerprint hits is verified)
+  BOOLEAN hash_keys;
+  c2dSize verify_keys; //verify one in verify_keys fingerprint hits (0 for none)
+  c2dSize compares;    //the number of fingerprint comparisons
+  c2dSize fp_hits;     //the number of fingerprint hits
+  c2dSize verified;    //the number of fingerprint hits verified against full keys
+  c2dSize false_hits;  //the number of verified fingerprint hits whose keys differ
+
+  //storage for entries and keys
+  VtreeCB* entry_blocks;  //blocks holding entries
+  VtreeCE* free_entries;  //entries which were dropped and can be reused
+  VtreeCB* key_blocks;    //key arena: keys are copied here by bumping a pointer
+  c2dSize key_live;       //bytes of the key arena holding keys of cache entries
+  c2dSize key_dead;       //bytes of the key arena holding keys of dropped entries
+  VtreeCB* count_blocks;  //arena for counts that do not fit in an entry (see count_exact.c)
+  c2dSize count_live;     //bytes of the arena of counts holding counts of cache entries
+  c2dSize count_dead;     //bytes of the arena of counts holding counts of dropped entries
+  VtreeCountCells count_cells; //the cells of a cached count (NULL if counts are stored in entries)
+  void* counts;           //state of the representation of counts (see count_kernel.h)
+  VtreeCV* pending;       //value being inserted (its count cells are moved with those of entries)
+
+  VtreeKeyIndex* key_index; //for maintaining key hash codes incrementally
+
+  ComponentCache* components; //for sharing counts between vtree nodes (NULL if not shared)
+  SavedCache* saved;          //counts loaded from a cache file (NULL if none)
 } VtreeCache;
 
 /******************************************************************************
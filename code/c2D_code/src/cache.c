@@ -1,258 +1,910 @@
-/******************************************************************************
- * The c2D Compiler Package
- * c2D version 1.00, May 24, 2015
- * http://reasoning.cs.ucla.edu/c2d
- ******************************************************************************/
-
-#include "c2d.h"
-
-//key.c
-void construct_vtree_key(DVtree *vtree);
-//utilities.c
-void pprint_bytes(const char* string, c2dSize bytes);
-
-//local declarations
-BOOLEAN match_keys(register BYTE* key1, register BYTE* key2, register c2dSize size);
-void copy_key(register BYTE* key1, register BYTE* key2, register c2dSize size);
-
-/******************************************************************************
- * the cache is implemented as an array of linked lists:
- *
- * --the elements of each linked list are cache entries
- * --a cache entry contains a key (identifies a cnf) and a computed value (count or nnf node)
- * --each key has a hash code (a number)
- * --cache entries in the same linked list have the same hashcode
- * --the hashcode indexes a cache entry into the cache (array of linked lists)
- *
- * each vtree node has a list of cache entries associated with it (i.e., cache entries
- * for cnfs that are associated with that vtree node). this additional indexing
- * facilitates dropping cache entries that are associated with a given vtree node
- *
- ******************************************************************************/
- 
-/******************************************************************************
- * constructing and freeing a cache
- *
- * these functions are called when constructing or freeing a vtree manager
- ******************************************************************************/
-
-VtreeCache* construct_vtree_cache(c2dSize capacity) {
-  VtreeCache* cache = (VtreeCache*) malloc(sizeof(VtreeCache));
-  
-  cache->buckets    = (VtreeCE**) calloc(capacity,sizeof(VtreeCE*));
-  cache->capacity   = capacity;
-  cache->count      = 0;
-  cache->memory     = 0;
-  cache->hits       = 0;
-  cache->misses     = 0;
-  return cache;
-}
-
-void free_cache_entry(VtreeCE* entry) {
-  free(entry->key);
-  free(entry);
-}
-
-void free_vtree_cache(VtreeCache* cache) {
-  //free cache entries
-  for(c2dSize i=0; i<cache->capacity; i++) {
-    VtreeCE* entry = cache->buckets[i];
-    while(entry!=NULL) {
-      VtreeCE* next = entry->next;
-      free_cache_entry(entry);
-      entry = next;
-    }
-  }
-  
-  free(cache->buckets); //free hash table
-  free(cache);
-}
-
-/******************************************************************************
- * which vtree nodes to cache at: CRITICAL to performance
- ******************************************************************************/
- 
-static BOOLEAN should_cache(const DVtree* vtree) {
-  return vtree->live_cache && 
-         vtree_is_shannon_node(vtree) && 
-         !sat_instantiated_var(vtree_shannon_var(vtree));
-}
-
-/******************************************************************************
- * lookup
- ******************************************************************************/
-
-//return 1 if lookup is successful, 0 otherwise
-//if lookup is successful, set the value of result accordingly
-BOOLEAN lookup_cache(VtreeCV* result, DVtree* vtree, VtreeManager* manager) {
-  if(!should_cache(vtree)) return 0;
-  assert(vtree->cached_size!=0);
-  
-  //capture the state of cnf associated with vtree as a bit vector and corresponding hash code
-  construct_vtree_key(vtree); 
-  //the following fields are now current
-  BYTE* key         = vtree->key; //bit vector
-  c2dSize size      = vtree->key_size;
-  HASHCODE hashcode = vtree->key_hashcode;
-    
-  VtreeCache* cache = manager->cache;
-  c2dSize index     = hashcode % cache->capacity;
-  VtreeCE* entry    = cache->buckets[index]; //first entry in collision list
-  
-  while(entry!=NULL) {
-    if(vtree==entry->vtree && match_keys(key,entry->key,size)) {
-      //hit
-      ++cache->hits;
-      *result = entry->value;
-      return 1;
-    }
-    else entry = entry->next;
-  }
-
-  //miss
-  ++cache->misses;
-  
-  return 0;
-}
- 
-/******************************************************************************
- * insert
- ******************************************************************************/
-
-//insert a computed value (count or nnf node) into the cache
-//the computed value is associated with the current cnf associated with the vtree node 
-//assume that lookup_cache has been already called to set the cnf key and hashcode
-void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager) {  
-  if(!should_cache(vtree)) return;
-  assert(vtree->cached_size!=0); 
-    
-  //key and hashcode are assumed current
-  VtreeCache* cache   = manager->cache;
-  HASHCODE hashcode   = vtree->key_hashcode;
-  BYTE* key           = vtree->key;
-  c2dSize key_size    = vtree->key_size;
-  c2dSize index       = hashcode % cache->capacity;
-  VtreeCE* head_entry = cache->buckets[index]; //head of collision list
-  
-  //create entry
-  VtreeCE* entry   = (VtreeCE*) malloc(sizeof(VtreeCE));
-  entry->value     = item;
-  entry->vtree     = vtree;
-  entry->key       = (BYTE*) calloc(key_size,sizeof(BYTE));
-  copy_key(key,entry->key,key_size); //entry key  
-     
-  //insert into hash table
-  entry->next           = head_entry;
-  cache->buckets[index] = entry; 
-  entry->prev_next      = cache->buckets+index;
-  if(head_entry!=NULL) head_entry->prev_next = &(entry->next);
-  
-  //add entry to list of cache entries for vtree
-  entry->vtree_next  = vtree->cache_entry;
-  vtree->cache_entry = entry;
-  
-  //update stats
-  ++cache->count;
-  cache->memory += sizeof(VtreeCE) + sizeof(BYTE)*vtree->key_size;
-}
- 
-/******************************************************************************
- * dropping entries
- ******************************************************************************/
-
-//remove cache entry from cache
-void drop_cache_entry(VtreeCE* entry, VtreeCache* cache) {
-  //remove from collision list
-  *(entry->prev_next) = entry->next; 
-  if(entry->next!=NULL) entry->next->prev_next = entry->prev_next;
-  //update stats
-  --cache->count;
-  cache->memory -= sizeof(VtreeCE) + sizeof(BYTE)*entry->vtree->key_size;
-  //free
-  free_cache_entry(entry);
-}
-
-//drop all cache entries of vtree and its descendants
-void drop_vtree_cache_entries(DVtree* vtree, VtreeManager* manager) {
-  if(vtree->left==NULL) return;
-  
-  VtreeCache* cache = manager->cache;
-  VtreeCE* entry    = vtree->cache_entry;
-  
-  while(entry!=NULL) {
-    VtreeCE* next = entry->vtree_next; //next in vtree list of entries
-    drop_cache_entry(entry,cache);
-    entry = next;
-  }
-  vtree->cache_entry = NULL;
-  
-  drop_vtree_cache_entries(vtree->left,manager);
-  drop_vtree_cache_entries(vtree->right,manager);
-}
- 
-/******************************************************************************
- * cache stats
- ******************************************************************************/
-
-void clist_size(VtreeCache* cache, c2dSize* max, double* ave, double* ave_key, double* max_key, double* min_key) {
-  *max = 0;
-  *ave = 0;
-  *ave_key = 0;
-  *max_key = 0;
-  *min_key = 10000000;
-
-  c2dSize bcount = 0; //number of non-empty buckets
-  for(c2dSize i=0; i<cache->capacity; i++) {
-    c2dSize count = 0;
-    VtreeCE* entry = cache->buckets[i];
-    while(entry != NULL) {
-      *ave_key += entry->vtree->key_size;
-      if(entry->vtree->key_size > *max_key) *max_key = entry->vtree->key_size;
-      if(entry->vtree->key_size < *min_key) *min_key = entry->vtree->key_size;
-      ++count;
-      entry = entry->next;
-    }
-    if(count) { //non-empty bucket
-      ++bcount;
-      *ave += count;
-    }
-    if(count > *max) {
-      *max = count;
-    }
-  }
-  *ave = *ave/bcount;
-  *ave_key = *ave_key/cache->count;
-}
-
-void print_vtree_cache_stats(VtreeCache* cache) {
-  c2dSize max_cl;
-  double ave_cl;
-  double ave_key, max_key, min_key;
-  clist_size(cache,&max_cl,&ave_cl,&ave_key,&max_key,&min_key);
-  
-  printf("\nCache stats:");
-  printf(     "\n  hit rate   \t%.1f%%",(100.0*cache->hits)/(cache->hits+cache->misses));
-  printf(     "\n  lookups    \t%"PRIvS"",cache->hits+cache->misses);
-  printf(     "\n  ent count  \t%"PRIvS"",cache->count);
-  pprint_bytes("\n  ent memory \t",cache->memory);
-  pprint_bytes("\n  ht  memory \t",cache->capacity*sizeof(VtreeCE*));
-  printf(     "\n  clists     \t%0.1f ave, %"PRIvS" max",ave_cl,max_cl);
-  printf(     "\n  keys       \t%.1fb ave, %.1fb max, %.1fb min",ave_key,max_key,min_key);
-}
-
-/******************************************************************************
- * utilities 
- ******************************************************************************/
-
-BOOLEAN match_keys(register BYTE* key1, register BYTE* key2, register c2dSize count) {
-  while(count--) if (*key1++ != *key2++) return 0;
-  return 1;
-}
-
-void copy_key(register BYTE* key, register BYTE* cells, register c2dSize count) {
-  while(count--) *cells++ = *key++;
-}
-
-/******************************************************************************
- * end
- ******************************************************************************/
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include <limits.h>
+#include "c2d.h"
+
+//key.c
+void construct_vtree_key(DVtree* vtree, const SatState* sat_state);
+void set_vtree_hashcode(DVtree* vtree, const SatState* sat_state);
+BOOLEAN incremental_vtree_key(const DVtree* vtree);
+void vtree_key_fingerprint(const DVtree* vtree, HASHCODE* fingerprint);
+//component.c
+ComponentCache* construct_component_cache();
+void free_component_cache(ComponentCache* components);
+BOOLEAN lookup_component(c2dWmc* count, DVtree* vtree, const VtreeCache* cache, const SatState* sat_state);
+void insert_component(c2dWmc count, DVtree* vtree, const VtreeCache* cache, const SatState* sat_state);
+void print_component_cache_stats(const ComponentCache* components);
+//cnf_key.c
+void attach_vtree_keys(VtreeManager* manager, SatState* sat_state);
+void detach_vtree_keys(SatState* sat_state);
+//cache_file.c
+BOOLEAN lookup_saved_cache(c2dWmc* count, DVtree* vtree, const VtreeCache* cache, const SatState* sat_state);
+void check_cache_signals(VtreeManager* manager, const SatState* sat_state);
+void print_saved_cache_stats(const SavedCache* saved);
+void free_saved_cache(SavedCache* saved);
+//utilities.c
+void pprint_bytes(const char* string, c2dSize bytes);
+
+//local declarations
+BOOLEAN match_keys(register BYTE* key1, register BYTE* key2, register c2dSize size);
+void copy_key(register BYTE* key1, register BYTE* key2, register c2dSize size);
+static c2dSize cache_footprint(const VtreeCache* cache);
+static void evict_cache_entry(VtreeCache* cache);
+static void make_room(c2dSize size, VtreeCache* cache);
+static void compact_count_arena(VtreeCache* cache);
+static void drop_node_cache_entries(DVtree* vtree, VtreeCache* cache);
+static void insert_vtree_entry(VtreeCV item, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
+static void drop_slot_entry(c2dSize index, VtreeCache* cache);
+static void unlink_cache_entry(VtreeCE* entry);
+static void sweep_cache(VtreeCache* cache);
+
+/******************************************************************************
+ * the cache is implemented as a flat open-addressing table (linear probing):
+ *
+ * --each slot of the table holds a cache entry and the hash code of its key
+ * --a cache entry contains a key (identifies a cnf) and a computed value (count or nnf node)
+ * --each key has a hash code (a number), which determines the home slot of its entry
+ * --an entry is stored in the first empty slot at or after its home slot
+ * --the table is doubled once the number of entries exceeds MAX_LOAD of its capacity
+ *
+ * entries are allocated in blocks and recycled when dropped, and keys are copied
+ * into an arena by bumping a pointer. hence, inserting an entry does not call malloc
+ * except when a new block is needed. the arena is compacted once the keys of dropped 
+ * entries occupy more space than the keys of live entries. counts that do not fit in
+ * an entry (see count_exact.c) are stored in a second arena, which is compacted likewise
+ *
+ * each vtree node has a list of cache entries associated with it (i.e., cache entries
+ * for cnfs that are associated with that vtree node). this additional indexing
+ * facilitates dropping cache entries that are associated with a given vtree node
+ *
+ * the cache may be given a memory budget. once inserting an entry would exceed it,
+ * entries are evicted using a clock over the slots: each hit on an entry protects
+ * it from eviction for one more pass of the clock (up to MAX_USES passes)
+ *
+ * the entries of a vtree node and its descendants are invalidated by advancing the
+ * epochs of these nodes, which occupy a contiguous range of vtree positions. entries
+ * inserted in an earlier epoch are stale: they never match a lookup, and are dropped
+ * when a lookup meets them, when the clock meets them, or by a sweep of the table 
+ * (instead of growing it, or before evicting live entries). when counting under
+ * evidence, the epoch of a vtree node also advances when the evidence on its variables
+ * changes
+ *
+ * entries may store fingerprints (128-bit hashes) of their keys instead of their keys,
+ * in which case two distinct keys of a vtree node match with probability 2^-128
+ *
+ * when counting, model counts may also be shared between vtree nodes with the same
+ * residual cnf: a miss is then looked up in a component table (see component.c)
+ *
+ * caching is switched off at a vtree node whose hit rate falls below a threshold (its
+ * entries are then dropped). the hit rate is checked after each lookup once the node has
+ * seen WARMUP_LOOKUPS lookups, and follows recent lookups: the hits and misses of a node
+ * are halved once they add up to HIT_RATE_WINDOW. caching is switched back on at the node
+ * after it skipped a number of lookups, which doubles each time it is switched off
+ *
+ * counts saved by an earlier run on the same cnf and vtree may be loaded from a cache
+ * file: a miss is then also looked up among them (see cache_file.c)
+ *
+ ******************************************************************************/
+
+//the table grows when count > MAX_LOAD_NUM/MAX_LOAD_DEN of capacity
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
+#define MAX_USES 3 //passes of the clock which an entry can survive without hits
+
+#define WARMUP_LOOKUPS  1024 //lookups at a vtree node before its hit rate is checked
+#define HIT_RATE_WINDOW 2048 //hits and misses of a vtree node are halved once they add up to this
+
+#define ENTRY_BLOCK_COUNT 4096    //entries per entry block
+#define KEY_BLOCK_SIZE    1048576 //minimum bytes per key block
+
+#define FINGERPRINT_SIZE  (2*sizeof(HASHCODE)) //bytes per fingerprint
+#define FINGERPRINT_SPACE 3.402823669209384634e38 //2^128 fingerprints
+
+//multiplier for fibonacci hashing (2^64 divided by the golden ratio)
+#define FIB_HASH 11400714819323198485UL
+
+static inline c2dSize home_slot(HASHCODE hashcode, const VtreeCache* cache) {
+  return (c2dSize)((hashcode*FIB_HASH)>>cache->shift);
+}
+
+//bytes of the key arena used by an entry of a vtree node with the given key size
+static inline c2dSize stored_key_size(c2dSize key_size, const VtreeCache* cache) {
+  if(!cache->hash_keys) return key_size;
+  return FINGERPRINT_SIZE + (cache->verify_keys? key_size: 0);
+}
+
+/******************************************************************************
+ * constructing and freeing a cache
+ *
+ * these functions are called when constructing or freeing a vtree manager
+ ******************************************************************************/
+
+static void allocate_slots(c2dSize capacity, VtreeCache* cache) {
+  c2dSize log = 0;
+  while(((c2dSize)1<<log) < capacity) ++log;
+  
+  cache->capacity = (c2dSize)1<<log;
+  cache->shift    = 8*sizeof(HASHCODE)-log;
+  cache->slots    = (VtreeCS*) calloc(cache->capacity,sizeof(VtreeCS));
+}
+
+VtreeCache* construct_vtree_cache(c2dSize capacity) {
+  VtreeCache* cache = (VtreeCache*) malloc(sizeof(VtreeCache));
+  
+  allocate_slots(capacity<2? 2: capacity,cache);
+  cache->count        = 0;
+  cache->memory       = 0;
+  cache->hits         = 0;
+  cache->misses       = 0;
+  cache->resizes      = 0;
+  cache->limit        = 0;
+  cache->evictions    = 0;
+  cache->clock_hand   = 0;
+  cache->nodes        = NULL;
+  cache->node_count   = 0;
+  cache->nodes_off    = 0;
+  cache->switches     = 0;
+  cache->min_hit_rate = 0;
+  cache->stale        = 0;
+  cache->sweeps       = 0;
+  cache->hash_keys    = 0;
+  cache->verify_keys  = 0;
+  cache->compares     = 0;
+  cache->fp_hits      = 0;
+  cache->verified     = 0;
+  cache->false_hits   = 0;
+  cache->entry_blocks = NULL;
+  cache->free_entries = NULL;
+  cache->key_blocks   = NULL;
+  cache->key_live     = 0;
+  cache->key_dead     = 0;
+  cache->count_blocks = NULL;
+  cache->count_live   = 0;
+  cache->count_dead   = 0;
+  cache->count_cells  = NULL;
+  cache->counts       = NULL;
+  cache->pending      = NULL;
+  cache->key_index    = NULL;
+  cache->components   = NULL;
+  cache->saved        = NULL;
+  return cache;
+}
+
+//allocate the activity records of vtree nodes (called once vtree keys are allocated)
+void allocate_vtree_cache_nodes(c2dSize count, VtreeCache* cache) {
+  cache->nodes      = (VtreeCN*) calloc(count,sizeof(VtreeCN));
+  cache->node_count = count;
+}
+
+//set the memory budget of cache (0 for no budget)
+//the slot array of an empty cache is shrunk to at most a quarter of the budget
+void set_vtree_cache_limit(c2dSize limit, VtreeCache* cache) {
+  cache->limit = limit;
+  if(limit && cache->count==0 && cache->capacity*sizeof(VtreeCS) > limit/4) {
+    c2dSize capacity = cache->capacity;
+    while(capacity>2 && capacity*sizeof(VtreeCS) > limit/4) capacity /= 2;
+    free(cache->slots);
+    allocate_slots(capacity,cache);
+  }
+}
+
+//switch caching off at vtree nodes whose hit rate falls below min_hit_rate (0 for never)
+void set_vtree_cache_min_hit_rate(double min_hit_rate, VtreeCache* cache) {
+  cache->min_hit_rate = min_hit_rate;
+}
+
+//store fingerprints of keys in cache entries, verifying one in verify_keys fingerprint 
+//hits against full keys (must be called before entries are inserted)
+void set_vtree_cache_fingerprints(BOOLEAN hash_keys, c2dSize verify_keys, VtreeCache* cache) {
+  assert(cache->count==0);
+  cache->hash_keys   = hash_keys;
+  cache->verify_keys = hash_keys? verify_keys: 0;
+}
+
+//set the cells of cached counts in the arena of counts (NULL if counts are stored in
+//entries), and the state of the representation of counts (see count_kernel.h)
+void set_vtree_cache_counts(VtreeCountCells count_cells, void* counts, VtreeCache* cache) {
+  cache->count_cells = count_cells;
+  cache->counts      = counts;
+}
+
+//share model counts between vtree nodes with the same residual cnf 
+//(only for counting, as cached nnf nodes mention the assigned variables of vtree nodes)
+void share_vtree_cache(VtreeCache* cache) {
+  cache->components = construct_component_cache();
+}
+
+static void free_blocks(VtreeCB* block) {
+  while(block!=NULL) {
+    VtreeCB* next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+void free_vtree_cache(VtreeCache* cache) {
+  free_blocks(cache->entry_blocks); //free cache entries
+  free_blocks(cache->key_blocks);   //free keys
+  free_blocks(cache->count_blocks); //free exact counts
+  free(cache->slots); //free hash table
+  free(cache->nodes); //free activity of vtree nodes
+  if(cache->components!=NULL) free_component_cache(cache->components);
+  if(cache->saved!=NULL) free_saved_cache(cache->saved);
+  free(cache);
+}
+
+/******************************************************************************
+ * allocating entries and keys
+ ******************************************************************************/
+
+static VtreeCB* new_block(c2dSize size, VtreeCB* next) {
+  VtreeCB* block = (VtreeCB*) malloc(sizeof(VtreeCB)+size);
+  block->next    = next;
+  block->size    = size;
+  block->used    = 0;
+  return block;
+}
+
+static VtreeCE* new_cache_entry(VtreeCache* cache) {
+  VtreeCE* entry = cache->free_entries;
+  if(entry!=NULL) {
+    cache->free_entries = entry->vtree_next;
+    return entry;
+  }
+  VtreeCB* block = cache->entry_blocks;
+  if(block==NULL || block->used==block->size) {
+    block = new_block(ENTRY_BLOCK_COUNT*sizeof(VtreeCE),block);
+    cache->entry_blocks = block;
+  }
+  entry = (VtreeCE*)(block->cells+block->used);
+  block->used += sizeof(VtreeCE);
+  return entry;
+}
+
+//returns the arena cells where a key of the given size can be stored
+static BYTE* new_key_cells(c2dSize size, VtreeCache* cache) {
+  VtreeCB* block = cache->key_blocks;
+  if(block==NULL || block->used+size > block->size) {
+    block = new_block(size>KEY_BLOCK_SIZE? size: KEY_BLOCK_SIZE,block);
+    cache->key_blocks = block;
+  }
+  BYTE* cells = block->cells+block->used;
+  block->used += size;
+  cache->key_live += size;
+  return cells;
+}
+
+//returns word-aligned space for size bytes in the arena of counts (see count_exact.c),
+//which must be given to a cache entry (the cells of dropped entries are reclaimed
+//by compact_count_arena)
+void* new_count_cells(c2dSize size, VtreeCache* cache) {
+  size = (size+sizeof(c2dSize)-1)/sizeof(c2dSize)*sizeof(c2dSize);
+  VtreeCB* block = cache->count_blocks;
+  if(block==NULL || block->used+size > block->size) {
+    block = new_block(size>KEY_BLOCK_SIZE? size: KEY_BLOCK_SIZE,block);
+    cache->count_blocks = block;
+  }
+  void* cells  = block->cells+block->used;
+  block->used += size;
+  cache->count_live += size;
+  return cells;
+}
+
+//free the arena of counts, once all cache entries are stale (they are dropped first)
+void free_count_cells(VtreeCache* cache) {
+  sweep_cache(cache);
+  assert(cache->count==0);
+  free_blocks(cache->count_blocks);
+  cache->count_blocks = NULL;
+  cache->count_live   = 0;
+  cache->count_dead   = 0;
+}
+
+//copy the counts of entries (and of the entry being inserted) into a fresh arena and 
+//free the old one
+static void compact_count_arena(VtreeCache* cache) {
+  if(cache->count_cells==NULL) return;
+  VtreeCB* old_blocks = cache->count_blocks;
+  cache->count_blocks = NULL;
+  cache->count_live   = 0;
+  cache->count_dead   = 0;
+
+  for(c2dSize i=0; i<cache->capacity; i++) {
+    VtreeCE* entry = cache->slots[i].entry;
+    if(entry!=NULL) cache->count_cells(&entry->value,1,cache);
+  }
+  if(cache->pending!=NULL) cache->count_cells(cache->pending,1,cache);
+
+  free_blocks(old_blocks);
+}
+
+//copy the keys of live entries into a fresh arena and free the old one
+static void compact_key_arena(VtreeCache* cache) {
+  VtreeCB* old_blocks = cache->key_blocks;
+  cache->key_blocks   = NULL;
+  cache->key_live     = 0;
+  cache->key_dead     = 0;
+  
+  for(c2dSize i=0; i<cache->capacity; i++) {
+    VtreeCE* entry = cache->slots[i].entry;
+    if(entry==NULL) continue;
+    c2dSize size = stored_key_size(entry->vtree->key_size,cache);
+    BYTE* cells  = new_key_cells(size,cache);
+    copy_key(entry->key,cells,size);
+    entry->key   = cells;
+  }
+  
+  free_blocks(old_blocks);
+}
+
+//double the number of slots and reinsert the entries (entries themselves do not move)
+static void grow_cache(VtreeCache* cache) {
+  c2dSize old_capacity = cache->capacity;
+  VtreeCS* old_slots   = cache->slots;
+  
+  allocate_slots(2*old_capacity,cache);
+  c2dSize mask = cache->capacity-1;
+  for(c2dSize i=0; i<old_capacity; i++) {
+    if(old_slots[i].entry==NULL) continue;
+    c2dSize j = home_slot(old_slots[i].hashcode,cache);
+    while(cache->slots[j].entry!=NULL) j = (j+1)&mask;
+    cache->slots[j] = old_slots[i];
+  }
+  
+  free(old_slots);
+  ++cache->resizes;
+}
+
+/******************************************************************************
+ * which vtree nodes to cache at: CRITICAL to performance
+ ******************************************************************************/
+ 
+static inline BOOLEAN cacheable(const DVtree* vtree) {
+  return vtree->live_cache && 
+         vtree_is_shannon_node(vtree) && 
+         !sat_instantiated_var(vtree_shannon_var(vtree));
+}
+
+static BOOLEAN should_cache(const DVtree* vtree, const VtreeCache* cache) {
+  return cacheable(vtree) && !cache->nodes[vtree->position].off;
+}
+
+//switch caching off at vtree if its recent hit rate is below the threshold, and
+//otherwise let its older lookups decay
+static void adapt_caching(DVtree* vtree, VtreeCache* cache) {
+  VtreeCN* node   = cache->nodes+vtree->position;
+  c2dSize lookups = node->hits+node->misses;
+  if(cache->min_hit_rate==0 || lookups<WARMUP_LOOKUPS) return;
+  if(node->hits < cache->min_hit_rate*lookups) {
+    printf("\n  caching off at vtree node %"PRIvS" (hit rate %.2f%% over %"PRIvS" lookups)",
+           vtree->position,(100.0*node->hits)/lookups,lookups);
+    node->off       = 1;
+    node->skipped   = 0;
+    node->probation = node->probation? 2*node->probation: WARMUP_LOOKUPS;
+    node->hits      = node->misses = 0;
+    ++cache->nodes_off;
+    ++cache->switches;
+    drop_node_cache_entries(vtree,cache);
+  }
+  else if(lookups>=HIT_RATE_WINDOW) {
+    node->hits   /= 2;
+    node->misses /= 2;
+  }
+}
+
+//switch caching back on at vtree once it has skipped enough lookups (returns whether it is on)
+static BOOLEAN probe_caching(DVtree* vtree, VtreeCache* cache) {
+  VtreeCN* node = cache->nodes+vtree->position;
+  if(!node->off) return 1;
+  if(++node->skipped < node->probation) return 0;
+  printf("\n  caching on at vtree node %"PRIvS" (after %"PRIvS" lookups off)",vtree->position,node->skipped);
+  node->off = 0;
+  --cache->nodes_off;
+  ++cache->switches;
+  return 1;
+}
+
+/******************************************************************************
+ * lookup
+ ******************************************************************************/
+
+//return 1 if lookup is successful, 0 otherwise
+//if lookup is successful, set the value of result accordingly
+BOOLEAN lookup_cache(VtreeCV* result, DVtree* vtree, VtreeManager* manager, SatState* sat_state) {
+  VtreeCache* cache = manager->cache;
+  if(!cacheable(vtree) || !probe_caching(vtree,cache)) return 0;
+  assert(vtree->cached_size!=0);
+  
+  //capture the state of cnf associated with vtree as a hash code (and a bit vector
+  //unless the hash code is maintained incrementally, see cnf_key.c)
+  set_vtree_hashcode(vtree,sat_state);
+  //the following fields are now current
+  HASHCODE hashcode = vtree->key_hashcode;
+  c2dSize size      = vtree->key_size;
+  //bit vector (constructed only once an entry with the same hash code is found if NULL)
+  BYTE* key         = incremental_vtree_key(vtree)? NULL: vtree->key;
+  unsigned int epoch = cache->nodes[vtree->position].epoch;
+  HASHCODE fingerprint[2];
+  BOOLEAN have_fingerprint = 0;
+    
+  c2dSize mask      = cache->capacity-1;
+  c2dSize index     = home_slot(hashcode,cache);
+  VtreeCS* slot     = cache->slots+index; //first slot in probe sequence
+  
+  while(slot->entry!=NULL) {
+    VtreeCE* entry = slot->entry;
+    if(slot->hashcode==hashcode && vtree==entry->vtree) {
+      if(entry->epoch!=epoch) { 
+        //stale: drop it (the next entry in probe sequence may move into this slot)
+        unlink_cache_entry(entry);
+        drop_slot_entry(index,cache);
+        continue;
+      }
+      if(key==NULL) {
+        construct_vtree_key(vtree,sat_state);
+        key = vtree->key;
+      }
+      BOOLEAN match;
+      if(cache->hash_keys) {
+        if(!have_fingerprint) {
+          vtree_key_fingerprint(vtree,fingerprint);
+          have_fingerprint = 1;
+        }
+        ++cache->compares;
+        match = match_keys((BYTE*)fingerprint,entry->key,FINGERPRINT_SIZE);
+        if(match) ++cache->fp_hits;
+        if(match && cache->verify_keys && cache->fp_hits%cache->verify_keys==0) {
+          ++cache->verified;
+          if(!match_keys(key,entry->key+FINGERPRINT_SIZE,size)) {
+            ++cache->false_hits;
+            match = 0;
+          }
+        }
+      }
+      else match = match_keys(key,entry->key,size);
+      if(match) { //otherwise, a hash collision
+        //hit
+        ++cache->hits;
+        ++cache->nodes[vtree->position].hits;
+        if(entry->uses<MAX_USES) ++entry->uses;
+        *result = entry->value;
+        adapt_caching(vtree,cache);
+        return 1;
+      }
+    }
+    index = (index+1)&mask;
+    slot  = cache->slots+index;
+  }
+
+  //miss
+  ++cache->misses;
+  ++cache->nodes[vtree->position].misses;
+  adapt_caching(vtree,cache);
+  
+  //a count found in the cache file or the component table is also cached at vtree, so that
+  //the next lookup of the same key hits (and counts towards the hit rate of vtree, see adapt_caching)
+  BOOLEAN off = cache->nodes[vtree->position].off; //caching may have just been switched off
+  if(cache->saved!=NULL && lookup_saved_cache(&result->count,vtree,cache,sat_state)) {
+    if(!off) insert_vtree_entry(*result,vtree,manager,sat_state);
+    return 1;
+  }
+  if(cache->components!=NULL && lookup_component(&result->count,vtree,cache,sat_state)) {
+    if(!off) insert_vtree_entry(*result,vtree,manager,sat_state);
+    return 1;
+  }
+  return 0;
+}
+ 
+/******************************************************************************
+ * insert
+ ******************************************************************************/
+
+//returns whether a value computed for vtree would be inserted into the cache now
+BOOLEAN vtree_cache_on(const DVtree* vtree, const VtreeManager* manager) {
+  return should_cache(vtree,manager->cache);
+}
+
+//insert a computed value (count or nnf node) into the cache
+//the computed value is associated with the current cnf associated with the vtree node 
+//assume that lookup_cache has been already called to set the cnf hashcode
+void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager, SatState* sat_state) {  
+  if(manager->cache->saved!=NULL) check_cache_signals(manager,sat_state);
+  if(!should_cache(vtree,manager->cache)) return;
+  assert(vtree->cached_size!=0); 
+  if(manager->cache->components!=NULL) insert_component(item.count,vtree,manager->cache,sat_state);
+  insert_vtree_entry(item,vtree,manager,sat_state);
+}
+
+//insert a value into the hash table (but not into the component table)
+static void insert_vtree_entry(VtreeCV item, DVtree* vtree, VtreeManager* manager, SatState* sat_state) {
+  //hashcode is assumed current, and so is the key unless its hash code is incremental
+  if(incremental_vtree_key(vtree)) construct_vtree_key(vtree,sat_state);
+  VtreeCache* cache   = manager->cache;
+  HASHCODE hashcode   = vtree->key_hashcode;
+  BYTE* key           = vtree->key;
+  c2dSize key_size    = vtree->key_size;
+  
+  c2dSize stored_size = stored_key_size(key_size,cache);
+  c2dSize memory      = sizeof(VtreeCE) + sizeof(BYTE)*stored_size;
+  cache->pending      = &item; //its count cells move if the arena of counts is compacted
+  if(cache->limit) make_room(memory,cache);
+  if(MAX_LOAD_DEN*(cache->count+1) > MAX_LOAD_NUM*cache->capacity) {
+    //sweep rather than grow if enough entries are stale, and evict rather than grow 
+    //if the larger slot array would exceed the budget
+    if(MAX_LOAD_DEN*cache->stale >= cache->count) sweep_cache(cache);
+    else if(cache->limit && cache_footprint(cache)+memory+cache->capacity*sizeof(VtreeCS) > cache->limit) 
+      evict_cache_entry(cache);
+    else grow_cache(cache);
+  }
+  
+  //create entry
+  VtreeCE* entry   = new_cache_entry(cache);
+  entry->value     = item;
+  entry->vtree     = vtree;
+  entry->hashcode  = hashcode;
+  entry->uses      = 1; //a new entry survives one pass of the clock
+  entry->epoch     = cache->nodes[vtree->position].epoch;
+  entry->key       = new_key_cells(stored_size,cache);
+  if(cache->hash_keys) {
+    HASHCODE fingerprint[2];
+    vtree_key_fingerprint(vtree,fingerprint);
+    copy_key((BYTE*)fingerprint,entry->key,FINGERPRINT_SIZE); //entry fingerprint
+    if(cache->verify_keys) copy_key(key,entry->key+FINGERPRINT_SIZE,key_size);
+  }
+  else copy_key(key,entry->key,key_size); //entry key  
+     
+  //insert into hash table: first empty slot in probe sequence
+  c2dSize mask  = cache->capacity-1;
+  c2dSize index = home_slot(hashcode,cache);
+  while(cache->slots[index].entry!=NULL) index = (index+1)&mask;
+  cache->slots[index].hashcode = hashcode;
+  cache->slots[index].entry    = entry;
+  
+  //add entry to list of cache entries for vtree
+  entry->vtree_next  = vtree->cache_entry;
+  entry->vtree_prev  = NULL;
+  if(vtree->cache_entry!=NULL) vtree->cache_entry->vtree_prev = entry;
+  vtree->cache_entry = entry;
+  
+  //update stats
+  ++cache->count;
+  ++cache->nodes[vtree->position].count;
+  cache->memory += memory;
+  cache->pending = NULL;
+}
+ 
+/******************************************************************************
+ * dropping entries
+ ******************************************************************************/
+
+//empty a slot, shifting back later entries of the probe sequence to fill the gap
+//(so that lookups never have to skip over deleted slots)
+static void empty_slot(c2dSize index, VtreeCache* cache) {
+  c2dSize mask = cache->capacity-1;
+  c2dSize next = index;
+  while(1) {
+    next = (next+1)&mask;
+    VtreeCS* slot = cache->slots+next;
+    if(slot->entry==NULL) break;
+    c2dSize home = home_slot(slot->hashcode,cache);
+    //entry can move back to index only if index is not before its home slot
+    if(((next-home)&mask) >= ((next-index)&mask)) {
+      cache->slots[index] = *slot;
+      index = next;
+    }
+  }
+  cache->slots[index].entry = NULL;
+}
+
+static inline BOOLEAN stale_cache_entry(const VtreeCE* entry, const VtreeCache* cache) {
+  return entry->epoch!=cache->nodes[entry->vtree->position].epoch;
+}
+
+//remove the entry in slot index from cache (without removing it from the list of 
+//cache entries for its vtree)
+static void drop_slot_entry(c2dSize index, VtreeCache* cache) {
+  VtreeCE* entry = cache->slots[index].entry;
+  empty_slot(index,cache);
+  //update stats
+  c2dSize key_size = stored_key_size(entry->vtree->key_size,cache);
+  if(stale_cache_entry(entry,cache)) --cache->stale;
+  else --cache->nodes[entry->vtree->position].count;
+  --cache->count;
+  cache->memory   -= sizeof(VtreeCE) + sizeof(BYTE)*key_size;
+  cache->key_live -= key_size;
+  cache->key_dead += key_size;
+  if(cache->count_cells!=NULL) {
+    c2dSize cells = cache->count_cells(&entry->value,0,cache);
+    cache->count_live -= cells;
+    cache->count_dead += cells;
+  }
+  //recycle
+  entry->vtree_next   = cache->free_entries;
+  cache->free_entries = entry;
+}
+
+//remove cache entry from cache
+void drop_cache_entry(VtreeCE* entry, VtreeCache* cache) {
+  c2dSize mask  = cache->capacity-1;
+  c2dSize index = home_slot(entry->hashcode,cache);
+  while(cache->slots[index].entry!=entry) index = (index+1)&mask;
+  drop_slot_entry(index,cache);
+}
+
+//remove cache entry from the list of cache entries for its vtree
+static void unlink_cache_entry(VtreeCE* entry) {
+  if(entry->vtree_prev!=NULL) entry->vtree_prev->vtree_next = entry->vtree_next;
+  else entry->vtree->cache_entry = entry->vtree_next;
+  if(entry->vtree_next!=NULL) entry->vtree_next->vtree_prev = entry->vtree_prev;
+}
+
+/******************************************************************************
+ * evicting entries
+ ******************************************************************************/
+
+//the memory used by cache, including the arena space of dropped keys and counts
+static c2dSize cache_footprint(const VtreeCache* cache) {
+  return cache->memory + cache->key_dead + cache->count_live + cache->count_dead + cache->capacity*sizeof(VtreeCS);
+}
+
+//evict the first entry found by the clock that is stale or has no uses left 
+//(uses of the entries passed over are decremented)
+static void evict_cache_entry(VtreeCache* cache) {
+  assert(cache->count>0);
+  c2dSize mask = cache->capacity-1;
+  VtreeCE* entry;
+  while(1) {
+    cache->clock_hand &= mask; //capacity may have changed
+    entry = cache->slots[cache->clock_hand].entry;
+    if(entry!=NULL) {
+      if(entry->uses==0 || stale_cache_entry(entry,cache)) break;
+      --entry->uses;
+    }
+    ++cache->clock_hand;
+  }
+  
+  unlink_cache_entry(entry);
+  drop_slot_entry(cache->clock_hand,cache);
+  ++cache->evictions;
+}
+
+//evict entries until an entry of the given size fits in the budget
+//(stale entries, then the arena space of dropped keys or counts when it dominates, are reclaimed first)
+static void make_room(c2dSize size, VtreeCache* cache) {
+  while(cache->count>0 && cache_footprint(cache)+size > cache->limit) {
+    if(cache->stale) sweep_cache(cache);
+    else if(cache->key_dead > cache->key_live) compact_key_arena(cache);
+    else if(cache->count_dead > cache->count_live) compact_count_arena(cache);
+    else evict_cache_entry(cache);
+  }
+}
+
+//drop all cache entries of vtree
+static void drop_node_cache_entries(DVtree* vtree, VtreeCache* cache) {
+  VtreeCE* entry = vtree->cache_entry;
+  
+  while(entry!=NULL) {
+    VtreeCE* next = entry->vtree_next; //next in vtree list of entries
+    drop_cache_entry(entry,cache);
+    entry = next;
+  }
+  vtree->cache_entry = NULL;
+}
+
+//drop all stale entries
+static void sweep_cache(VtreeCache* cache) {
+  c2dSize i = 0;
+  while(cache->stale && i<cache->capacity) {
+    VtreeCE* entry = cache->slots[i].entry;
+    if(entry!=NULL && stale_cache_entry(entry,cache)) {
+      unlink_cache_entry(entry);
+      drop_slot_entry(i,cache); //a later entry may move into slot i
+    }
+    else ++i;
+  }
+  ++cache->sweeps;
+  //reclaim the arena space of dropped keys and counts once it dominates
+  if(cache->key_dead > KEY_BLOCK_SIZE && cache->key_dead > cache->key_live) compact_key_arena(cache);
+  if(cache->count_dead > KEY_BLOCK_SIZE && cache->count_dead > cache->count_live) compact_count_arena(cache);
+}
+
+//make the entries of a vtree node stale
+static void advance_node_epoch(VtreeCN* node, VtreeCache* cache) {
+  //an epoch must not be reused while entries of the node may carry it
+  if(node->epoch==UINT_MAX) sweep_cache(cache);
+  ++node->epoch;
+  cache->stale += node->count;
+  node->count   = 0;
+}
+
+//invalidate all cache entries of vtree and its descendants: 
+//these nodes have positions first..last, where first and last are the positions of 
+//the leftmost and rightmost leaves of vtree
+void drop_vtree_cache_entries(DVtree* vtree, VtreeManager* manager) {
+  if(vtree->left==NULL) return;
+  VtreeCache* cache = manager->cache;
+  
+  DVtree* leaf = vtree;
+  while(leaf->left!=NULL) leaf = leaf->left;
+  c2dSize first = leaf->position;
+  leaf = vtree;
+  while(leaf->right!=NULL) leaf = leaf->right;
+  c2dSize last = leaf->position;
+  
+  for(VtreeCN* node=cache->nodes+first; node<=cache->nodes+last; node++) advance_node_epoch(node,cache);
+}
+
+//a hash of literal l (entries of a vtree node are tagged with the sum of the hashes of
+//the evidence literals on its variables)
+static inline HASHCODE evidence_hash(c2dLiteral l) {
+  HASHCODE h = (HASHCODE)l*0x9E3779B97F4A7C15UL;
+  h = (h^(h>>30))*0xBF58476D1CE4E5B9UL;
+  h = (h^(h>>27))*0x94D049BB133111EBUL;
+  return h^(h>>31);
+}
+
+//invalidate the entries of vtree nodes whose evidence differs from that of their entries:
+//keys do not capture decisions on variables inside a vtree node, but an entry remains 
+//valid under any evidence that agrees with its own on the variables of its node
+void set_evidence_epochs(const c2dLiteral* evidence, c2dSize size, VtreeManager* manager) {
+  VtreeCache* cache = manager->cache;
+  HASHCODE* hashes  = (HASHCODE*) calloc(cache->node_count,sizeof(HASHCODE));
+  for(c2dSize i=0; i<size; i++) {
+    HASHCODE hash = evidence_hash(evidence[i]);
+    for(DVtree* vtree=manager->var_map[labs(evidence[i])]; vtree!=NULL; vtree=vtree->parent) 
+      hashes[vtree->position] += hash;
+  }
+  for(c2dSize p=0; p<cache->node_count; p++) {
+    VtreeCN* node = cache->nodes+p;
+    if(node->evidence==hashes[p]) continue;
+    node->evidence = hashes[p];
+    advance_node_epoch(node,cache);
+  }
+  free(hashes);
+}
+
+//undo evidence decisions until learned_clause is at its assertion level, and assert it
+//returns 0 if the clause asserts below all evidence decisions (the cnf is inconsistent)
+static BOOLEAN assert_under_evidence(Clause* learned_clause, c2dSize* decisions, SatState* sat_state) {
+  while(learned_clause!=NULL) {
+    while(!sat_at_assertion_level(learned_clause,sat_state)) {
+      if(*decisions==0) return 0;
+      sat_undo_decide_literal(sat_state);
+      --*decisions;
+    }
+    //if another clause is learned, its assertion level must be lower
+    learned_clause = sat_assert_clause(learned_clause,sat_state);
+  }
+  return 1;
+}
+
+//calls run(learned_clause,data), which counts or compiles a vtree node below the Shannon
+//nodes of all evidence variables, after deciding the evidence literals that are not implied
+//when run learns a clause, the clause is asserted and run is called again (after deciding 
+//the remaining evidence). returns 0 if the cnf is inconsistent with evidence (run did not
+//complete), and 1 otherwise
+BOOLEAN run_under_evidence(const c2dLiteral* evidence, c2dSize size, void (*run)(Clause** learned_clause, void* data), void* data, VtreeManager* manager, SatState* sat_state) {
+
+  Clause* learned_clause = NULL;
+  c2dSize decisions      = 0;
+  BOOLEAN consistent     = 1;
+
+  attach_vtree_keys(manager,sat_state);
+  set_evidence_epochs(evidence,size,manager);
+  if(sat_unit_resolution(sat_state)) { //unit resolution succeeded
+    while(consistent) {
+      //decide the evidence literals that are not implied
+      for(c2dSize i=0; i<size && learned_clause==NULL && consistent; i++) {
+        Lit* lit = sat_index2literal(evidence[i],sat_state);
+        if(sat_implied_literal(lit)) continue;
+        if(sat_implied_literal(sat_index2literal(-evidence[i],sat_state))) consistent = 0;
+        else {
+          learned_clause = sat_decide_literal(lit,sat_state);
+          ++decisions;
+        }
+      }
+      if(!consistent) break; //evidence contradicts the cnf
+      if(learned_clause==NULL) {
+        run(&learned_clause,data);
+        if(learned_clause==NULL) break; //completed
+      }
+      //assert the learned clause, and decide the remaining evidence again
+      consistent     = assert_under_evidence(learned_clause,&decisions,sat_state);
+      learned_clause = NULL;
+    }
+  }
+  else consistent = 0; //cnf is inconsistent
+
+  for(; decisions>0; decisions--) sat_undo_decide_literal(sat_state);
+  sat_undo_unit_resolution(sat_state);
+  detach_vtree_keys(sat_state);
+  return consistent;
+}
+ 
+/******************************************************************************
+ * cache stats
+ ******************************************************************************/
+
+//probe lengths (distance of entries from their home slots) and key sizes
+void probe_stats(VtreeCache* cache, c2dSize* max, double* ave, double* ave_key, double* max_key, double* min_key) {
+  *max = 0;
+  *ave = 0;
+  *ave_key = 0;
+  *max_key = 0;
+  *min_key = cache->count? 10000000: 0;
+
+  c2dSize mask = cache->capacity-1;
+  for(c2dSize i=0; i<cache->capacity; i++) {
+    VtreeCE* entry = cache->slots[i].entry;
+    if(entry==NULL) continue;
+    c2dSize probe = 1+((i-home_slot(cache->slots[i].hashcode,cache))&mask);
+    *ave += probe;
+    if(probe > *max) *max = probe;
+    *ave_key += entry->vtree->key_size;
+    if(entry->vtree->key_size > *max_key) *max_key = entry->vtree->key_size;
+    if(entry->vtree->key_size < *min_key) *min_key = entry->vtree->key_size;
+  }
+  if(cache->count) {
+    *ave = *ave/cache->count;
+    *ave_key = *ave_key/cache->count;
+  }
+}
+
+void print_vtree_cache_stats(VtreeCache* cache) {
+  c2dSize max_probe;
+  double ave_probe;
+  double ave_key, max_key, min_key;
+  probe_stats(cache,&max_probe,&ave_probe,&ave_key,&max_key,&min_key);
+  
+  c2dSize arena = 0;
+  for(VtreeCB* block=cache->key_blocks; block!=NULL; block=block->next) arena += block->size;
+  
+  printf("\nCache stats:");
+  printf(     "\n  hit rate   \t%.1f%%",(100.0*cache->hits)/(cache->hits+cache->misses));
+  printf(     "\n  lookups    \t%"PRIvS"",cache->hits+cache->misses);
+  printf(     "\n  ent count  \t%"PRIvS"",cache->count);
+  pprint_bytes("\n  ent memory \t",cache->memory);
+  pprint_bytes("\n  key arena  \t",arena);
+  if(cache->count_blocks!=NULL) pprint_bytes("\n  cnt arena  \t",cache->count_live+cache->count_dead);
+  pprint_bytes("\n  ht  memory \t",cache->capacity*sizeof(VtreeCS));
+  printf(     "\n  load       \t%.2f (%"PRIvS" slots, %"PRIvS" resizes)",(double)cache->count/cache->capacity,cache->capacity,cache->resizes);
+  printf(     "\n  probes     \t%0.1f ave, %"PRIvS" max",ave_probe,max_probe);
+  printf(     "\n  keys       \t%.1fb ave, %.1fb max, %.1fb min",ave_key,max_key,min_key);
+  if(cache->min_hit_rate) 
+    printf(   "\n  nodes off  \t%"PRIvS" (%"PRIvS" switches, hit rate below %g%%)",cache->nodes_off,cache->switches,100*cache->min_hit_rate);
+  if(cache->components!=NULL) print_component_cache_stats(cache->components);
+  if(cache->saved!=NULL) print_saved_cache_stats(cache->saved);
+  printf(     "\n  stale      \t%"PRIvS" (%"PRIvS" sweeps)",cache->stale,cache->sweeps);
+  if(cache->hash_keys) {
+    //each comparison of fingerprints of distinct keys is a false hit with probability 2^-128
+    printf(   "\n  fingerprint\t%"PRIvS" compares, false hit probability <= %.1e",cache->compares,cache->compares/FINGERPRINT_SPACE);
+    if(cache->verify_keys) 
+      printf( "\n  verified   \t%"PRIvS" of %"PRIvS" hits, %"PRIvS" false",cache->verified,cache->fp_hits,cache->false_hits);
+  }
+  if(cache->limit) {
+    printf(     "\n  evictions  \t%"PRIvS"",cache->evictions);
+    pprint_bytes(" (budget ",cache->limit); printf(")");
+  }
+}
+
+/******************************************************************************
+ * utilities 
+ ******************************************************************************/
+
+BOOLEAN match_keys(register BYTE* key1, register BYTE* key2, register c2dSize count) {
+  while(count--) if (*key1++ != *key2++) return 0;
+  return 1;
+}
+
+void copy_key(register BYTE* key, register BYTE* cells, register c2dSize count) {
+  while(count--) *cells++ = *key++;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,369 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _DEFAULT_SOURCE //alarm and SIGUSR1
+#include <signal.h>
+#include <unistd.h>
+#include "c2d.h"
+
+//cnf_key.c
+void construct_vtree_key(DVtree* vtree, const SatState* sat_state);
+BOOLEAN incremental_vtree_key(const DVtree* vtree);
+void vtree_key_fingerprint(const DVtree* vtree, HASHCODE* fingerprint);
+//utilities.c
+void pprint_bytes(const char* string, c2dSize bytes);
+HASHCODE cnf_fingerprint(const SatState* sat_state);
+
+/******************************************************************************
+ * saving the counts of the vtree cache to a file, and loading them in a later run
+ * (to resume an interrupted run, or to recount the same cnf)
+ *
+ * a cache file starts with fingerprints of the cnf (clauses and literal weights) and
+ * of the vtree (structure and key sizes), as keys are bit vectors over the context
+ * clauses and variables of vtree nodes: a file saved for another cnf or vtree is
+ * ignored. each entry then holds the position of its vtree node, the hash code of its
+ * key, its count, and its key (or fingerprint) as stored in the vtree cache. the file
+ * ends with the clauses learned by the sat state, which are added to the sat state of
+ * the later run
+ *
+ * loaded counts are kept in a table of their own, which is looked up on a miss of the
+ * vtree cache (a hit is then inserted into the vtree cache). unlike vtree cache entries,
+ * they are not dropped when a conflict drops the entries of a vtree node, as they were
+ * not computed under its current decisions
+ *
+ * the file is saved once counting is done, or once counting is interrupted (SIGINT or
+ * SIGTERM, noticed at the next insertion into the vtree cache, where it is consistent).
+ * it holds the loaded counts and the vtree cache entries that are neither stale nor
+ * computed under evidence on the variables of their vtree nodes, and is written to a
+ * temporary file which then replaces it (so a failed save leaves the old file intact)
+ *
+ * the file is also saved as a checkpoint, without stopping, on SIGUSR1 and periodically
+ * (see set_cache_checkpoints). a resumed run searches from the root again, but branches
+ * completed before the checkpoint are found in the cache (at their first cached vtree
+ * nodes), so it only redoes the work of branches that were not completed
+ ******************************************************************************/
+
+#define CACHE_FILE_MAGIC "c2Dcache"
+
+#define FINGERPRINT_SIZE (2*sizeof(HASHCODE)) //bytes per fingerprint (see cache.c)
+
+//multiplier for fibonacci hashing (2^64 divided by the golden ratio)
+#define FIB_HASH 11400714819323198485UL
+
+typedef struct {
+  char magic[8];
+  HASHCODE cnf;        //fingerprint of the cnf
+  HASHCODE vtree;      //fingerprint of the vtree
+  c2dSize hash_keys;   //as in the vtree cache
+  c2dSize verify_keys; //as in the vtree cache
+  c2dSize count;       //the number of entries
+  c2dSize learned;     //the number of learned clauses (after the entries)
+} CacheFileHeader;
+
+//set by SIGINT and SIGTERM
+static volatile sig_atomic_t interrupted = 0;
+//set by SIGUSR1 and SIGALRM
+static volatile sig_atomic_t checkpoint_due = 0;
+static unsigned int checkpoint_period = 0; //seconds (0 for no periodic checkpoints)
+
+//bytes of a key as stored by the vtree cache (see stored_key_size in cache.c)
+static inline c2dSize saved_key_size(const DVtree* vtree, const VtreeCache* cache) {
+  if(!cache->hash_keys) return vtree->key_size;
+  return FINGERPRINT_SIZE + (cache->verify_keys? vtree->key_size: 0);
+}
+
+//a fingerprint of the structure of vtree and the key sizes of its nodes
+static HASHCODE vtree_fingerprint(const DVtree* vtree) {
+  HASHCODE hashcode = vtree->position+1;
+  if(vtree_is_leaf(vtree)) hashcode = hashcode*31 + sat_var_index(vtree->var);
+  else {
+    hashcode = hashcode*31 + vtree->key_size;
+    hashcode = hashcode*31 + vtree_fingerprint(vtree->left);
+    hashcode = hashcode*31 + vtree_fingerprint(vtree->right);
+  }
+  hashcode ^= hashcode>>29;
+  return hashcode*0xBF58476D1CE4E5B9UL;
+}
+
+static void cache_file_header(CacheFileHeader* header, const VtreeManager* manager, const SatState* sat_state) {
+  memcpy(header->magic,CACHE_FILE_MAGIC,sizeof(header->magic));
+  header->cnf         = cnf_fingerprint(sat_state);
+  header->vtree       = vtree_fingerprint(manager->vtree);
+  header->hash_keys   = manager->cache->hash_keys;
+  header->verify_keys = manager->cache->verify_keys;
+  header->count       = 0;
+  header->learned     = sat_learned_clause_count(sat_state);
+}
+
+static void index_vtree_nodes(DVtree* vtree, DVtree** nodes) {
+  nodes[vtree->position] = vtree;
+  if(vtree->left!=NULL) {
+    index_vtree_nodes(vtree->left,nodes);
+    index_vtree_nodes(vtree->right,nodes);
+  }
+}
+
+/******************************************************************************
+ * the table of loaded counts
+ ******************************************************************************/
+
+static SavedCache* new_saved_cache(const char* fname, c2dSize count, c2dSize key_bytes) {
+  SavedCache* saved = (SavedCache*) malloc(sizeof(SavedCache));
+  c2dSize log = 1;
+  while(((c2dSize)1<<log) < 2*count) ++log; //at most half full
+  saved->fname       = fname;
+  saved->capacity    = (c2dSize)1<<log;
+  saved->shift       = 8*sizeof(HASHCODE)-log;
+  saved->slots       = (SavedCE*) calloc(saved->capacity,sizeof(SavedCE));
+  saved->count       = 0;
+  saved->keys        = (BYTE*) malloc(key_bytes? key_bytes: 1);
+  saved->key_bytes   = 0;
+  saved->hits        = 0;
+  saved->checkpoints = 0;
+  return saved;
+}
+
+void free_saved_cache(SavedCache* saved) {
+  free(saved->slots);
+  free(saved->keys);
+  free(saved);
+}
+
+static inline c2dSize saved_slot(HASHCODE hashcode, const SavedCache* saved) {
+  return (c2dSize)((hashcode*FIB_HASH)>>saved->shift);
+}
+
+//returns the entry of the vtree node at position with the given key, or NULL if none
+//(size bytes of the key are compared)
+static SavedCE* find_saved_entry(c2dSize position, HASHCODE hashcode, const BYTE* key, c2dSize size, const SavedCache* saved) {
+  c2dSize mask = saved->capacity-1;
+  for(c2dSize index=saved_slot(hashcode,saved); saved->slots[index].node!=0; index=(index+1)&mask) {
+    SavedCE* entry = saved->slots+index;
+    if(entry->hashcode==hashcode && entry->node==position+1 && !memcmp(saved->keys+entry->key,key,size)) return entry;
+  }
+  return NULL;
+}
+
+//return 1 if the current key of vtree has a loaded count (setting count), 0 otherwise
+//(the hash code of vtree is assumed current, see lookup_cache)
+BOOLEAN lookup_saved_cache(c2dWmc* count, DVtree* vtree, const VtreeCache* cache, const SatState* sat_state) {
+  SavedCache* saved = cache->saved;
+  if(saved->count==0 || cache->nodes[vtree->position].evidence!=0) return 0; //counts were saved without evidence
+  HASHCODE hashcode = vtree->key_hashcode;
+  c2dSize mask      = saved->capacity-1;
+  c2dSize index     = saved_slot(hashcode,saved);
+  while(saved->slots[index].node!=0 &&
+        (saved->slots[index].hashcode!=hashcode || saved->slots[index].node!=vtree->position+1)) index = (index+1)&mask;
+  if(saved->slots[index].node==0) return 0;
+
+  //an entry with the same hash code: compare keys (or fingerprints)
+  if(incremental_vtree_key(vtree)) construct_vtree_key(vtree,sat_state);
+  SavedCE* entry;
+  if(cache->hash_keys) {
+    HASHCODE fingerprint[2];
+    vtree_key_fingerprint(vtree,fingerprint);
+    entry = find_saved_entry(vtree->position,hashcode,(BYTE*)fingerprint,FINGERPRINT_SIZE,saved);
+  }
+  else entry = find_saved_entry(vtree->position,hashcode,vtree->key,vtree->key_size,saved);
+  if(entry==NULL) return 0;
+  ++saved->hits;
+  *count = entry->count;
+  return 1;
+}
+
+static void add_saved_entry(c2dSize position, HASHCODE hashcode, c2dWmc count, c2dSize size, SavedCache* saved) {
+  c2dSize mask  = saved->capacity-1;
+  c2dSize index = saved_slot(hashcode,saved);
+  while(saved->slots[index].node!=0) index = (index+1)&mask;
+  SavedCE* entry  = saved->slots+index;
+  entry->hashcode = hashcode;
+  entry->node     = position+1;
+  entry->count    = count;
+  entry->key      = saved->key_bytes; //already read into the key cells
+  saved->key_bytes += size;
+  ++saved->count;
+}
+
+/******************************************************************************
+ * loading and saving
+ ******************************************************************************/
+
+static void interrupt_handler(int signal_number) {
+  interrupted = 1;
+}
+
+static void checkpoint_handler(int signal_number) {
+  checkpoint_due = 1;
+}
+
+//read the learned clauses at the end of a cache file into sat state
+static BOOLEAN read_learned_clauses(c2dSize count, FILE* file, SatState* sat_state) {
+  c2dLiteral* literals = (c2dLiteral*) malloc((sat_var_count(sat_state)+1)*sizeof(c2dLiteral));
+  BOOLEAN ok = 1;
+  for(c2dSize i=0; ok && i<count; i++) {
+    c2dSize size;
+    ok = fread(&size,sizeof(c2dSize),1,file)==1 && size>0 && size<=sat_var_count(sat_state) &&
+         fread(literals,sizeof(c2dLiteral),size,file)==size;
+    for(c2dSize j=0; ok && j<size; j++) ok = literals[j]!=0 && (c2dSize)labs(literals[j])<=sat_var_count(sat_state);
+    if(ok) sat_add_learned_clause(literals,size,sat_state);
+  }
+  free(literals);
+  return ok;
+}
+
+//load the counts saved in fname (if it exists) for later lookups, and its learned clauses
+//into sat state. the counts (with those of the vtree cache) and learned clauses are saved 
+//to fname once counting is done or interrupted
+//returns 0 if fname was saved for another cnf, vtree or key representation (it is then ignored)
+BOOLEAN open_vtree_cache_file(const char* fname, VtreeManager* manager, SatState* sat_state) {
+  VtreeCache* cache = manager->cache;
+  signal(SIGINT,interrupt_handler);
+  signal(SIGTERM,interrupt_handler);
+  signal(SIGUSR1,checkpoint_handler);
+
+  FILE* file = fopen(fname,"rb");
+  if(file==NULL) {
+    cache->saved = new_saved_cache(fname,0,0);
+    return 1;
+  }
+  CacheFileHeader expected, header;
+  cache_file_header(&expected,manager,sat_state);
+  if(fread(&header,sizeof(header),1,file)!=1 || memcmp(header.magic,expected.magic,sizeof(header.magic)) ||
+     header.cnf!=expected.cnf || header.vtree!=expected.vtree ||
+     header.hash_keys!=expected.hash_keys || header.verify_keys!=expected.verify_keys) {
+    fclose(file);
+    cache->saved = new_saved_cache(fname,0,0);
+    return 0;
+  }
+
+  //keys take at most the bytes of the file after the header and the fixed fields of entries
+  long start = ftell(file);
+  fseek(file,0,SEEK_END);
+  long end   = ftell(file);
+  fseek(file,start,SEEK_SET);
+  c2dSize fixed = header.count*(sizeof(c2dSize)+sizeof(HASHCODE)+sizeof(c2dWmc));
+  BOOLEAN ok    = end-start >= (long)fixed;
+  SavedCache* saved = new_saved_cache(fname,header.count,ok? end-start-fixed: 0);
+
+  DVtree** nodes = (DVtree**) calloc(cache->node_count,sizeof(DVtree*));
+  index_vtree_nodes(manager->vtree,nodes);
+  for(c2dSize i=0; ok && i<header.count; i++) {
+    c2dSize position;
+    HASHCODE hashcode;
+    c2dWmc count;
+    ok = fread(&position,sizeof(c2dSize),1,file)==1 && position<cache->node_count && nodes[position]->key_size!=0 &&
+         fread(&hashcode,sizeof(HASHCODE),1,file)==1 && fread(&count,sizeof(c2dWmc),1,file)==1;
+    c2dSize size = ok? saved_key_size(nodes[position],cache): 0;
+    ok = ok && saved->key_bytes+size <= (c2dSize)(end-start)-fixed && fread(saved->keys+saved->key_bytes,size,1,file)==1;
+    if(ok) add_saved_entry(position,hashcode,count,size,saved);
+  }
+  if(ok) ok = read_learned_clauses(header.learned,file,sat_state);
+  if(!ok) {
+    fprintf(stderr,"\nc2D: cache file %s is truncated\n",fname);
+    exit(1);
+  }
+  free(nodes);
+  fclose(file);
+  cache->saved = saved;
+  return 1;
+}
+
+//save a checkpoint every period seconds (also saved on SIGUSR1)
+void set_cache_checkpoints(unsigned int period) {
+  checkpoint_period = period;
+  signal(SIGALRM,checkpoint_handler);
+  alarm(period);
+}
+
+static inline BOOLEAN saved_vtree_entry(const VtreeCE* entry, const VtreeCache* cache) {
+  const VtreeCN* node = cache->nodes+entry->vtree->position;
+  if(entry->epoch!=node->epoch || node->evidence!=0) return 0; //stale, or computed under evidence
+  //a loaded count inserted into the vtree cache is saved once
+  return find_saved_entry(entry->vtree->position,entry->hashcode,entry->key,saved_key_size(entry->vtree,cache),cache->saved)==NULL;
+}
+
+static BOOLEAN write_entry(c2dSize position, HASHCODE hashcode, c2dWmc count, const BYTE* key, c2dSize size, FILE* file) {
+  return fwrite(&position,sizeof(c2dSize),1,file)==1 && fwrite(&hashcode,sizeof(HASHCODE),1,file)==1 &&
+         fwrite(&count,sizeof(c2dWmc),1,file)==1 && (size==0 || fwrite(key,size,1,file)==1);
+}
+
+//save the loaded counts and the counts of the vtree cache to the cache file, returning
+//the number of entries saved
+c2dSize save_vtree_cache_file(VtreeManager* manager, const SatState* sat_state) {
+  VtreeCache* cache = manager->cache;
+  SavedCache* saved = cache->saved;
+  CacheFileHeader header;
+  cache_file_header(&header,manager,sat_state);
+  header.count = saved->count;
+  for(c2dSize i=0; i<cache->capacity; i++) {
+    VtreeCE* entry = cache->slots[i].entry;
+    if(entry!=NULL && saved_vtree_entry(entry,cache)) ++header.count;
+  }
+
+  DVtree** nodes = (DVtree**) calloc(cache->node_count,sizeof(DVtree*));
+  index_vtree_nodes(manager->vtree,nodes);
+  char* tmp_fname = (char*) malloc(strlen(saved->fname)+5);
+  sprintf(tmp_fname,"%s.tmp",saved->fname);
+  FILE* file = fopen(tmp_fname,"wb");
+  BOOLEAN ok = file!=NULL && fwrite(&header,sizeof(header),1,file)==1;
+  for(c2dSize i=0; ok && i<saved->capacity; i++) {
+    SavedCE* entry = saved->slots+i;
+    if(entry->node==0) continue;
+    c2dSize position = entry->node-1;
+    ok = write_entry(position,entry->hashcode,entry->count,saved->keys+entry->key,saved_key_size(nodes[position],cache),file);
+  }
+  for(c2dSize i=0; ok && i<cache->capacity; i++) {
+    VtreeCE* entry = cache->slots[i].entry;
+    if(entry==NULL || !saved_vtree_entry(entry,cache)) continue;
+    ok = write_entry(entry->vtree->position,entry->hashcode,entry->value.count,entry->key,saved_key_size(entry->vtree,cache),file);
+  }
+  for(c2dSize i=1; ok && i<=header.learned; i++) {
+    Clause* clause = sat_index2clause(sat_clause_count(sat_state)+i,sat_state);
+    c2dSize size   = sat_clause_size(clause);
+    ok = fwrite(&size,sizeof(c2dSize),1,file)==1;
+    for(c2dSize j=0; ok && j<size; j++) {
+      c2dLiteral literal = sat_literal_index(sat_clause_literals(clause)[j]);
+      ok = fwrite(&literal,sizeof(c2dLiteral),1,file)==1;
+    }
+  }
+  if(file!=NULL && fclose(file)!=0) ok = 0;
+  if(!ok || rename(tmp_fname,saved->fname)!=0) {
+    fprintf(stderr,"\nc2D: cannot write cache file %s\n",saved->fname);
+    exit(1);
+  }
+  free(tmp_fname);
+  free(nodes);
+  return header.count;
+}
+
+//save the cache file and exit once interrupted, or save a checkpoint once one is due
+//(called before inserting into the vtree cache)
+void check_cache_signals(VtreeManager* manager, const SatState* sat_state) {
+  if(interrupted) {
+    c2dSize count = save_vtree_cache_file(manager,sat_state);
+    printf("\nInterrupted: saved %"PRIvS" cache entries to %s\n",count,manager->cache->saved->fname);
+    exit(1);
+  }
+  if(checkpoint_due) {
+    checkpoint_due = 0;
+    save_vtree_cache_file(manager,sat_state);
+    ++manager->cache->saved->checkpoints;
+    if(checkpoint_period) alarm(checkpoint_period);
+  }
+}
+
+/******************************************************************************
+ * stats
+ ******************************************************************************/
+
+void print_saved_cache_stats(const SavedCache* saved) {
+  printf(     "\n  cache file \t%"PRIvS" hits, %"PRIvS" entries loaded, %"PRIvS" checkpoints",saved->hits,saved->count,saved->checkpoints);
+  pprint_bytes(", ",saved->capacity*sizeof(SavedCE)+saved->key_bytes);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -5,6 +5,14 @@
  ******************************************************************************/
 
 #include "c2d.h"
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+//keys with at least this many bits have their hash codes maintained incrementally
+#ifndef INCREMENTAL_KEY_SIZE
+#define INCREMENTAL_KEY_SIZE 1024
+#endif
 
 /******************************************************************************
  * component caching is based on the following concepts:
@@ -14,81 +22,208 @@
  *   of variables set (by decisions) or implied (by unit resolution))
  * --the state of this cnf is identified by a key, which is a bit vector
  * --a cache entry contains a key (cnf) and a cached value (model count, or nnf node)
- * --a key has a hash code, which indexes its cache entry into the cache (array 
- *   of collision lists) 
+ * --a key has a hash code, which indexes its cache entry into the cache
+ *
+ * for vtree nodes with narrow contexts, keys and their hash codes are computed
+ * dynamically each time a vtree node is visited during model counting or compilation.
  *
- * keys and their hash codes are computed dynamically each time a vtree node is
- * visited during model counting or compilation.
+ * for vtree nodes with wide contexts, hash codes are maintained incrementally
+ * (Zobrist hashing): each context clause and each literal of a context variable has
+ * a random word, and the hash code of a vtree node is the xor of the words of its
+ * subsumed context clauses and implied context literals. the sat state notifies us
+ * when a clause or literal changes state, and its word is then xor-ed into the hash
+ * codes of the vtree nodes whose contexts include it. the keys (bit vectors) of these
+ * nodes are constructed only when needed: when a cache lookup finds an entry with
+ * the same hash code, and when inserting an entry.
  *
  * the space for keys (bit vectors) is allocated before counting/compilation starts
  *
  ******************************************************************************/
- 
+
+//cache.c
+void allocate_vtree_cache_nodes(c2dSize count, VtreeCache* cache);
+
+/******************************************************************************
+ * random words
+ ******************************************************************************/
+
+//splitmix64: a fixed seed makes hash codes (and hence runs) reproducible
+static HASHCODE next_word(HASHCODE* seed) {
+  HASHCODE z = (*seed += 0x9E3779B97F4A7C15UL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+  return z ^ (z >> 31);
+}
+
+static inline c2dSize literal_word_index(const Lit* lit) {
+  c2dLiteral index = sat_literal_index(lit);
+  return index>0? 2*index+1: 2*(-index);
+}
+
 /******************************************************************************
  * hashcode
  ******************************************************************************/
- 
-//compute and store a hash code for the current key associated with vtree
-void set_vtree_hashcode(DVtree* vtree) {
-  c2dSize size = vtree->key_size;
-  BYTE* key    = vtree->key;
-  
-  HASHCODE hashcode = vtree->position; //was 0
-  while(size--) hashcode = 31*hashcode + *key++;
-  vtree->key_hashcode = hashcode;
+
+//hash codes are only needed at vtree nodes where caching may take place (see cache.c)
+static BOOLEAN has_hashcode(const DVtree* vtree) {
+  return vtree->key!=NULL && vtree->live_cache && vtree_is_shannon_node(vtree);
+}
+
+//a hash code is maintained incrementally only if its key is wide: each change of the 
+//sat state is xor-ed into every vtree node whose context includes it, which costs 
+//more than constructing and hashing the key on demand when contexts are narrow
+BOOLEAN incremental_vtree_key(const DVtree* vtree) {
+  return vtree->cached_size>=INCREMENTAL_KEY_SIZE;
+}
+
+//xor the word of a clause into the (incremental) vtree nodes whose context includes it
+static void clause_observer(const Clause* clause, void* data) {
+  VtreeKeyState* state = (VtreeKeyState*) data;
+  VtreeKeyIndex* index = state->index;
+  c2dSize i = sat_clause_index(clause);
+  if(i>=index->clause_count) return; //learned clause
+
+  HASHCODE word = index->clause_words[i];
+  for(c2dSize j=index->clause_start[i]; j<index->clause_start[i+1]; j++)
+    state->hashcodes[index->clause_nodes[j]] ^= word;
+}
+
+//xor the word of a literal into the (incremental) vtree nodes whose context includes its variable
+static void literal_observer(const Lit* lit, void* data) {
+  VtreeKeyState* state = (VtreeKeyState*) data;
+  VtreeKeyIndex* index = state->index;
+  c2dSize i = sat_var_index(sat_literal_var(lit));
+  if(i>=index->var_count) return; //variable in no context
+
+  HASHCODE word = index->literal_words[literal_word_index(lit)];
+  for(c2dSize j=index->var_start[i]; j<index->var_start[i+1]; j++)
+    state->hashcodes[index->var_nodes[j]] ^= word;
+}
+
+//compute the hash code of a vtree node from scratch
+static HASHCODE compute_vtree_hashcode(const DVtree* vtree, const VtreeKeyIndex* index) {
+  HASHCODE hashcode = 0;
+  for(c2dSize i=0; i<vtree->contextC->size; i++) {
+    Clause* clause = vtree->contextC->set[i];
+    if(sat_subsumed_clause(clause)) hashcode ^= index->clause_words[sat_clause_index(clause)];
+  }
+  for(c2dSize i=0; i<vtree->context_in_vars->size; i++) {
+    Var* var  = vtree->context_in_vars->set[i];
+    Lit* plit = sat_pos_literal(var);
+    Lit* nlit = sat_neg_literal(var);
+    if(sat_implied_literal(plit)) hashcode ^= index->literal_words[literal_word_index(plit)];
+    if(sat_implied_literal(nlit)) hashcode ^= index->literal_words[literal_word_index(nlit)];
+  }
+  return hashcode;
+}
+
+static void compute_vtree_hashcodes(const DVtree* vtree, VtreeKeyState* state) {
+  if(vtree->left==NULL) return;
+  if(has_hashcode(vtree) && incremental_vtree_key(vtree)) state->hashcodes[vtree->position] = compute_vtree_hashcode(vtree,state->index);
+  compute_vtree_hashcodes(vtree->left,state);
+  compute_vtree_hashcodes(vtree->right,state);
 }
 
 /******************************************************************************
  * constructing keys
  ******************************************************************************/
 
-#define SET_NEXT_BIT(bit) {\
-  if(bit_count==8) { /* current cell is full */\
-    ++cell; /* move to next cell */\
-    *cell = 0; /* clear its 8 bits */\
-    bit_count = 0; /* no bit has been set in this cell */\
-  }\
-  *cell <<= 1; /* shift left one bit to make room for new bit */\
-  if(bit) *cell |= (BYTE)1; /* set bit if 1, otherwise already 0 */\
-  ++bit_count;\
+//return the bits of word selected by mask, packed into the low bits (in order)
+static inline unsigned long extract_bits(unsigned long word, unsigned long mask) {
+#if defined(__BMI2__)
+  return _pext_u64(word,mask);
+#else
+  unsigned long bits = 0;
+  for(unsigned long bit=1; mask; mask &= mask-1, bit <<= 1)
+    if(word & mask & -mask) bits |= bit;
+  return bits;
+#endif
 }
 
 //construct and store a key for the current cnf associated with a vtree node
-//the key is a bit vector, with one bit for each clause (subsumed or not) and 
+//the key is a bit vector, with one bit for each clause (subsumed or not) and
 //two bits for each variable (free, true, false)
-void construct_vtree_key(DVtree* vtree) {
+//
+//the bits are gathered a word at a time from the packed sat state: clause bits
+//ordered by clause index, followed by literal bits ordered by variable index
+void construct_vtree_key(DVtree* vtree, const SatState* sat_state) {
   assert(vtree->cached_size!=0);
-  
-  //last cell may be partially filled
-  //initializing cells to 0 ensures that padded bits are always 0
-  BYTE* cell           = vtree->key; //first cell to be filled
-  *cell                = 0; //clear bits of cell
-  short bit_count      = 0; //next bit to be set in cell
-  
-  //iterate over context clauses
-  for(c2dSize i=0; i<vtree->contextC->size; i++) {
-    Clause* clause = vtree->contextC->set[i]; 
-    BOOLEAN bit = sat_subsumed_clause(clause);
-    SET_NEXT_BIT(bit);
+  VtreeKeyState* state       = (VtreeKeyState*) sat_observer_data(sat_state);
+  VtreeKeyMask* mask         = state->index->masks+vtree->position;
+  const unsigned long* cbits = sat_subsumed_bits(sat_state);
+  const unsigned long* lbits = sat_implied_bits(sat_state);
+
+  BYTE* cell         = vtree->key; //first cell to be filled
+  unsigned long bits = 0; //bits not yet stored in cells
+  c2dSize bit_count  = 0; //number of such bits
+  for(c2dSize i=0; i<mask->count; i++) {
+    VtreeKeyGather* gather = mask->gathers+i;
+    const unsigned long* words = i<mask->clause_count? cbits: lbits;
+    unsigned long x = extract_bits(words[gather->word],gather->mask);
+    bits      |= x << bit_count;
+    bit_count += gather->size;
+    if(bit_count>=SAT_WORD_BITS) { //store a full word
+      memcpy(cell,&bits,sizeof(bits));
+      cell      += sizeof(bits);
+      bit_count -= SAT_WORD_BITS;
+      bits       = bit_count? x >> (gather->size-bit_count): 0;
+    }
   }
-  
-  //bits of literals for context clauses
-  for(c2dSize i=0; i<vtree->context_in_vars->size; i++) {
-    Var* var = vtree->context_in_vars->set[i];
-    //00: var is free
-    //01: var is false
-    //10: var is true
-    BOOLEAN pbit = 0;
-    BOOLEAN nbit = 0;
-    Lit* plit = sat_pos_literal(var);
-    Lit* nlit = sat_neg_literal(var);
-    if(sat_implied_literal(plit)) pbit = 1;
-    if(sat_implied_literal(nlit)) nbit = 1;
-    SET_NEXT_BIT(pbit);
-    SET_NEXT_BIT(nbit);
+  //last cell may be partially filled, its padded bits are always 0
+  for(; bit_count>0; bit_count -= bit_count<8? bit_count: 8) {
+    *cell++ = (BYTE) bits;
+    bits >>= 8;
   }
- 
-  set_vtree_hashcode(vtree);
+}
+
+/******************************************************************************
+ * hashcode of the current key
+ ******************************************************************************/
+
+//compute and store a hash code for the current key associated with vtree
+//if the hash code is not maintained incrementally, the key is constructed first
+void set_vtree_hashcode(DVtree* vtree, const SatState* sat_state) {
+  HASHCODE hashcode;
+  if(incremental_vtree_key(vtree)) {
+    VtreeKeyState* state = (VtreeKeyState*) sat_observer_data(sat_state);
+    //distinguish vtree nodes whose keys have the same words
+    hashcode = state->hashcodes[vtree->position] ^ ((vtree->position+1)*0xBF58476D1CE4E5B9UL);
+  }
+  else {
+    construct_vtree_key(vtree,sat_state);
+    c2dSize size = vtree->key_size;
+    BYTE* key    = vtree->key;
+    hashcode     = vtree->position; //was 0
+    while(size--) hashcode = 31*hashcode + *key++;
+  }
+  vtree->key_hashcode = hashcode;
+}
+
+/******************************************************************************
+ * fingerprint of the current key
+ ******************************************************************************/
+
+//a 128-bit hash of the current key associated with vtree (assumed constructed): the
+//key is read 8 bytes at a time into two lanes with different seeds and multipliers
+void vtree_key_fingerprint(const DVtree* vtree, HASHCODE* fingerprint) {
+  HASHCODE seed1 = 0x243F6A8885A308D3UL^vtree->key_size;
+  HASHCODE seed2 = 0x13198A2E03707344UL;
+  HASHCODE h1    = next_word(&seed1);
+  HASHCODE h2    = next_word(&seed2);
+  const BYTE* key = vtree->key;
+  c2dSize size    = vtree->key_size;
+  while(size) {
+    HASHCODE word = 0;
+    c2dSize n = size<sizeof(HASHCODE)? size: sizeof(HASHCODE);
+    memcpy(&word,key,n);
+    key  += n;
+    size -= n;
+    h1 = (h1^word)*0x9E3779B97F4A7C15UL; h1 ^= h1>>29;
+    h2 = (h2^word)*0xD6E8FEB86659FD93UL; h2 ^= h2>>32;
+  }
+  //final mixing (splitmix64 finalizer)
+  seed1 = h1; fingerprint[0] = next_word(&seed1);
+  seed2 = h2; fingerprint[1] = next_word(&seed2);
 }
 
 /******************************************************************************
@@ -96,7 +231,7 @@ void construct_vtree_key(DVtree* vtree) {
  ******************************************************************************/
 
 //return the number of bytes needed to store n bits
-static c2dSize bits2bytes(c2dSize n) { 
+static c2dSize bits2bytes(c2dSize n) {
   c2dSize x = 8*sizeof(BYTE);
   return (n%x? (n/x)+1: n/x);
 }
@@ -105,8 +240,8 @@ void allocate_vtree_keys(DVtree* vtree, VtreeManager* manager) {
   vtree->key_size    = 0;
   vtree->key         = NULL;
   vtree->cache_entry = NULL;
-  
-  if(vtree->left!=NULL) {  
+
+  if(vtree->left!=NULL) {
     if(vtree->cached_size!=0) {
       c2dSize size    = vtree->cached_size;
       vtree->key_size = bits2bytes(size);
@@ -125,12 +260,174 @@ void free_vtree_keys(DVtree* vtree) {
   }
 }
 
+/******************************************************************************
+ * constructing and freeing the index of key masks and words
+ ******************************************************************************/
+
+//only the contexts of vtree nodes with incremental hash codes are indexed
+//pass 0: find the largest clause/variable index in contexts
+//pass 1: count the vtree nodes of each clause/variable
+//pass 2: fill the vtree nodes of each clause/variable
+static void index_vtree_contexts(int pass, const DVtree* vtree, VtreeKeyIndex* index) {
+  if(vtree->left==NULL) return;
+  if(has_hashcode(vtree) && incremental_vtree_key(vtree)) {
+    for(c2dSize i=0; i<vtree->contextC->size; i++) {
+      c2dSize c = sat_clause_index(vtree->contextC->set[i]);
+      if(pass==0 && c>=index->clause_count) index->clause_count = c+1;
+      else if(pass==1) ++index->clause_start[c+1];
+      else if(pass==2) index->clause_nodes[index->clause_start[c]++] = vtree->position;
+    }
+    for(c2dSize i=0; i<vtree->context_in_vars->size; i++) {
+      c2dSize v = sat_var_index(vtree->context_in_vars->set[i]);
+      if(pass==0 && v>=index->var_count) index->var_count = v+1;
+      else if(pass==1) ++index->var_start[v+1];
+      else if(pass==2) index->var_nodes[index->var_start[v]++] = vtree->position;
+    }
+  }
+  index_vtree_contexts(pass,vtree->left,index);
+  index_vtree_contexts(pass,vtree->right,index);
+}
+
+//turn counts into start offsets (shifted by one so pass 2 restores them)
+static void counts2offsets(c2dSize* start, c2dSize count) {
+  for(c2dSize i=1; i<=count; i++) start[i] += start[i-1];
+}
+
+static void restore_offsets(c2dSize* start, c2dSize count) {
+  for(c2dSize i=count; i>0; i--) start[i] = start[i-1];
+  start[0] = 0;
+}
+
+static int compare_sizes(const void* a, const void* b) {
+  c2dSize x = *(const c2dSize*)a;
+  c2dSize y = *(const c2dSize*)b;
+  return x<y? -1: (x>y? 1: 0);
+}
+
+//append gathers for the bits in bits[0..count-1] (bits are sorted first)
+static void add_gathers(c2dSize* bits, c2dSize count, VtreeKeyMask* mask) {
+  qsort(bits,count,sizeof(c2dSize),compare_sizes);
+  c2dSize first = mask->count; //first gather added
+  for(c2dSize i=0; i<count; i++) {
+    c2dSize word = bits[i]/SAT_WORD_BITS;
+    if(mask->count==first || mask->gathers[mask->count-1].word!=word) { //start a new gather
+      VtreeKeyGather* gather = mask->gathers+mask->count++;
+      gather->word = word;
+      gather->mask = 0;
+      gather->size = 0;
+    }
+    VtreeKeyGather* gather = mask->gathers+mask->count-1;
+    gather->mask |= 1UL << (bits[i]%SAT_WORD_BITS);
+    ++gather->size;
+  }
+}
+
+//compute the masks for gathering the key of each vtree node from the packed sat state
+static void construct_vtree_masks(const DVtree* vtree, VtreeKeyMask* masks) {
+  if(vtree->left==NULL) return;
+  VtreeKeyMask* mask = masks+vtree->position;
+  if(has_hashcode(vtree)) {
+    c2dSize csize = vtree->contextC->size;
+    c2dSize vsize = vtree->context_in_vars->size;
+    c2dSize* bits = (c2dSize*) malloc((csize+2*vsize)*sizeof(c2dSize));
+    mask->gathers = (VtreeKeyGather*) malloc((csize+2*vsize)*sizeof(VtreeKeyGather));
+    //clauses
+    for(c2dSize i=0; i<csize; i++) bits[i] = sat_clause_index(vtree->contextC->set[i]);
+    add_gathers(bits,csize,mask);
+    mask->clause_count = mask->count;
+    //literals
+    for(c2dSize i=0; i<vsize; i++) {
+      c2dSize v = sat_var_index(vtree->context_in_vars->set[i]);
+      bits[2*i]   = 2*v;
+      bits[2*i+1] = 2*v+1;
+    }
+    add_gathers(bits,2*vsize,mask);
+    free(bits);
+  }
+  construct_vtree_masks(vtree->left,masks);
+  construct_vtree_masks(vtree->right,masks);
+}
+
+static VtreeKeyIndex* construct_key_index(const DVtree* vtree) {
+  VtreeKeyIndex* index = (VtreeKeyIndex*) malloc(sizeof(VtreeKeyIndex));
+  index->node_count    = 2*vtree->var_count-1;
+  index->clause_count  = 0;
+  index->var_count     = 0;
+  index_vtree_contexts(0,vtree,index);
+
+  c2dSize ccount = index->clause_count;
+  c2dSize vcount = index->var_count;
+  index->clause_start  = (c2dSize*) calloc(ccount+1,sizeof(c2dSize));
+  index->var_start     = (c2dSize*) calloc(vcount+1,sizeof(c2dSize));
+  index_vtree_contexts(1,vtree,index);
+  counts2offsets(index->clause_start,ccount);
+  counts2offsets(index->var_start,vcount);
+  index->clause_nodes  = (c2dSize*) malloc((index->clause_start[ccount]+1)*sizeof(c2dSize));
+  index->var_nodes     = (c2dSize*) malloc((index->var_start[vcount]+1)*sizeof(c2dSize));
+  index_vtree_contexts(2,vtree,index);
+  restore_offsets(index->clause_start,ccount);
+  restore_offsets(index->var_start,vcount);
+
+  index->masks = (VtreeKeyMask*) calloc(index->node_count,sizeof(VtreeKeyMask));
+  construct_vtree_masks(vtree,index->masks);
+
+  HASHCODE seed = 0;
+  index->clause_words  = (HASHCODE*) malloc((ccount+1)*sizeof(HASHCODE));
+  index->literal_words = (HASHCODE*) malloc((2*vcount+2)*sizeof(HASHCODE));
+  for(c2dSize i=0; i<ccount; i++) index->clause_words[i] = next_word(&seed);
+  for(c2dSize i=0; i<2*vcount; i++) index->literal_words[i] = next_word(&seed);
+  return index;
+}
+
+static void free_key_index(VtreeKeyIndex* index) {
+  for(c2dSize p=0; p<index->node_count; p++) free(index->masks[p].gathers);
+  free(index->masks);
+  free(index->clause_words);
+  free(index->literal_words);
+  free(index->clause_start);
+  free(index->clause_nodes);
+  free(index->var_start);
+  free(index->var_nodes);
+  free(index);
+}
+
+/******************************************************************************
+ * keys of a vtree manager
+ ******************************************************************************/
+
 void allocate_manager_keys(VtreeManager* manager) {
   allocate_vtree_keys(manager->vtree,manager);
+  allocate_vtree_cache_nodes(2*manager->vtree->var_count-1,manager->cache);
 }
 
 void free_manager_keys(VtreeManager* manager) {
   free_vtree_keys(manager->vtree);
+  if(manager->cache->key_index!=NULL) free_key_index(manager->cache->key_index);
+  manager->cache->key_index = NULL;
+}
+
+//start maintaining the hash codes of vtree keys under sat state
+void attach_vtree_keys(VtreeManager* manager, SatState* sat_state) {
+  VtreeCache* cache = manager->cache;
+  //the index is constructed on first use, once the nodes which may cache are known
+  if(cache->key_index==NULL) cache->key_index = construct_key_index(manager->vtree);
+  VtreeKeyIndex* index = cache->key_index;
+  VtreeKeyState* state = (VtreeKeyState*) malloc(sizeof(VtreeKeyState));
+  state->index     = index;
+  state->hashcodes = (HASHCODE*) calloc(index->node_count,sizeof(HASHCODE));
+  compute_vtree_hashcodes(manager->vtree,state);
+  //observe the sat state only if some hash code is maintained incrementally
+  if(index->clause_count+index->var_count>0)
+    sat_set_observers(clause_observer,literal_observer,state,sat_state);
+  else sat_set_observers(NULL,NULL,state,sat_state);
+}
+
+//stop maintaining the hash codes of vtree keys under sat state
+void detach_vtree_keys(SatState* sat_state) {
+  VtreeKeyState* state = (VtreeKeyState*) sat_observer_data(sat_state);
+  sat_set_observers(NULL,NULL,NULL,sat_state);
+  free(state->hashcodes);
+  free(state);
 }
 
 /******************************************************************************
@@ -7,17 +7,25 @@
 #include "c2d.h"
 
 //cache.c
-BOOLEAN lookup_cache(VtreeCV* item, DVtree* vtree, VtreeManager* manager);
-void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager);
+BOOLEAN lookup_cache(VtreeCV* item, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
+void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
 void drop_vtree_cache_entries(DVtree* vtree, VtreeManager* manager);
+BOOLEAN run_under_evidence(const c2dLiteral* evidence, c2dSize size, void (*run)(Clause** learned_clause, void* data), void* data, VtreeManager* manager, SatState* sat_state);
+//cnf_key.c
+void attach_vtree_keys(VtreeManager* manager, SatState* sat_state);
+void detach_vtree_keys(SatState* sat_state);
+//nnf_unique.c
+NnfNode* unique_literal(const Lit* lit, const UniqueNnf* nnf);
+NnfNode* unique_conjoin(NnfNode* node1, NnfNode* node2, UniqueNnf* nnf);
+NnfNode* unique_disjoin(const Var* var, NnfNode* node1, NnfNode* node2, UniqueNnf* nnf);
 
 //local
-void compile_dispatcher(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state);
+void compile_dispatcher(NnfNode** node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, UniqueNnf* nnf_manager, SatState* sat_state);
 
 /******************************************************************************
  * Three compilation cases: leaf nodes, decomposition nodes, and Shannon nodes
  *
- * All cases take (NNF_NODE* node, Clause** learned_clause) as their first arguments
+ * All cases take (NnfNode** node, Clause** learned_clause) as their first arguments
  *
  * After a case returns:
  * --if *learned_clause==NULL, then *node contains the corresponding compilation
@@ -34,29 +42,49 @@ void compile_dispatcher(NNF_NODE* node, Clause** learned_clause, DVtree* vtree,
  * Main compilation code
  ******************************************************************************/
  
-//hash table capacity (formula caching and unique nodes)
-//primes: 10007, 20011, 30011, 40009, 50021, 65599, 100003, 2015179,  20000003
-#define UNIQUE_TABLE_CAPACITY 20000003
+//returns the root of the compiled nnf, whose nodes are in nnf_manager
+NnfNode* compile_vtree(VtreeManager* manager, UniqueNnf* nnf_manager, SatState* sat_state) {
 
-extern NNF_NODE ZERO_NNF_NODE;
-extern NNF_NODE ONE_NNF_NODE;
-
-NnfManager* compile_vtree(VtreeManager* manager, SatState* sat_state) {
-
-  NNF_NODE node;
+  NnfNode* node;
   Clause* learned_clause  = NULL;
   DVtree* vtree           = manager->vtree;
-  NnfManager* nnf_manager = nnf_manager_new(sat_state,UNIQUE_TABLE_CAPACITY);
 
+  attach_vtree_keys(manager,sat_state);
   if(sat_unit_resolution(sat_state)) { //unit resolution succeeded
     compile_dispatcher(&node,&learned_clause,vtree,manager,nnf_manager,sat_state);
-    if(learned_clause!=NULL) node = ZERO_NNF_NODE; //cnf is inconsistent
+    if(learned_clause!=NULL) node = nnf_manager->zero; //cnf is inconsistent
   }
-  else node = ZERO_NNF_NODE; //cnf is inconsistent
+  else node = nnf_manager->zero; //cnf is inconsistent
 
   sat_undo_unit_resolution(sat_state);
-  nnf_manager_set_root(node,nnf_manager);
-  return nnf_manager;
+  detach_vtree_keys(sat_state);
+  return node;
+}
+
+/******************************************************************************
+ * Compilation under evidence (literals that are assumed true), as in count_kernel.h
+ ******************************************************************************/
+
+typedef struct {
+  DVtree* vtree;
+  VtreeManager* manager;
+  UniqueNnf* nnf_manager;
+  SatState* sat_state;
+  NnfNode* node;
+} EvidenceCompilation;
+
+static void compile_under_evidence(Clause** learned_clause, void* data) {
+  EvidenceCompilation* job = (EvidenceCompilation*) data;
+  compile_dispatcher(&job->node,learned_clause,job->vtree,job->manager,job->nnf_manager,job->sat_state);
+}
+
+//compile vtree (a node below the Shannon nodes of all evidence variables) under evidence
+//(see run_under_evidence in cache.c). nodes of the returned nnf are in nnf_manager, which
+//must be the same for all calls (as its nodes are cached)
+NnfNode* compile_vtree_evidence(const c2dLiteral* evidence, c2dSize size, DVtree* vtree, VtreeManager* manager, UniqueNnf* nnf_manager, SatState* sat_state) {
+  EvidenceCompilation job = { vtree, manager, nnf_manager, sat_state, NULL };
+  if(!run_under_evidence(evidence,size,compile_under_evidence,&job,manager,sat_state)) job.node = nnf_manager->zero;
+  return job.node;
 }
 
 /******************************************************************************
@@ -67,15 +95,15 @@ NnfManager* compile_vtree(VtreeManager* manager, SatState* sat_state) {
  * Case I: leaf vtree (compilation depends on state of associated variable)
  ******************************************************************************/
 
-NNF_NODE var2nnf(Var* var, NnfManager* nnf_manager) {
+NnfNode* var2nnf(Var* var, UniqueNnf* nnf_manager) {
   Lit* plit = sat_pos_literal(var);
   Lit* nlit = sat_neg_literal(var);
-  if(sat_implied_literal(plit))      return nnf_literal2node(plit,nnf_manager);
-  else if(sat_implied_literal(nlit)) return nnf_literal2node(nlit,nnf_manager);
-  else return ONE_NNF_NODE;
+  if(sat_implied_literal(plit))      return unique_literal(plit,nnf_manager);
+  else if(sat_implied_literal(nlit)) return unique_literal(nlit,nnf_manager);
+  else return nnf_manager->one;
 }
 
-void compile_vtree_leaf(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, NnfManager* nnf_manager) {
+void compile_vtree_leaf(NnfNode** node, Clause** learned_clause, DVtree* vtree, UniqueNnf* nnf_manager) {
   assert(vtree_is_leaf(vtree));
   *node = var2nnf(vtree->var,nnf_manager);
   *learned_clause = NULL;
@@ -85,16 +113,16 @@ void compile_vtree_leaf(NNF_NODE* node, Clause** learned_clause, DVtree* vtree,
  * Case II: decomposition node (left and right vtrees are independent)
  ******************************************************************************/
 
-void compile_vtree_decomposed(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+void compile_vtree_decomposed(NnfNode** node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, UniqueNnf* nnf_manager, SatState* sat_state) {
 
-  NNF_NODE l_node;
+  NnfNode* l_node;
   compile_dispatcher(&l_node,learned_clause,vtree->left,vtree_manager,nnf_manager,sat_state);
   if(*learned_clause!=NULL) {
     drop_vtree_cache_entries(vtree->left,vtree_manager);
     return;
   }
 
-  NNF_NODE r_node;
+  NnfNode* r_node;
   compile_dispatcher(&r_node,learned_clause,vtree->right,vtree_manager,nnf_manager,sat_state);
   if(*learned_clause!=NULL) {
     drop_vtree_cache_entries(vtree,vtree_manager);
@@ -102,17 +130,17 @@ void compile_vtree_decomposed(NNF_NODE* node, Clause** learned_clause, DVtree* v
   }
 
   assert(*learned_clause==NULL);
-  *node = nnf_conjoin(l_node,r_node,nnf_manager);
+  *node = unique_conjoin(l_node,r_node,nnf_manager);
 }
 
 /******************************************************************************
  * Case III: Shannon node (compilation based on case analysis)
  ******************************************************************************/
 
-void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state);
+void compile_vtree_shannon(NnfNode** node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, UniqueNnf* nnf_manager, SatState* sat_state);
 
 static inline
-BOOLEAN compile_with_literal(NNF_NODE* node, Clause** learned_clause, Lit* literal, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+BOOLEAN compile_with_literal(NnfNode** node, Clause** learned_clause, Lit* literal, DVtree* vtree, VtreeManager* vtree_manager, UniqueNnf* nnf_manager, SatState* sat_state) {
   *learned_clause     = sat_decide_literal(literal,sat_state);
   if(*learned_clause==NULL) compile_dispatcher(node,learned_clause,vtree->right,vtree_manager,nnf_manager,sat_state);
   sat_undo_decide_literal(sat_state);
@@ -128,12 +156,12 @@ BOOLEAN compile_with_literal(NNF_NODE* node, Clause** learned_clause, Lit* liter
   else return 1; //compiling with literal succeeded without learning clauses
 }
 
-void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+void compile_vtree_shannon(NnfNode** node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, UniqueNnf* nnf_manager, SatState* sat_state) {
   Var* var = vtree_shannon_var(vtree);
 
   if(sat_instantiated_var(var) || sat_irrelevant_var(var)) {
     compile_dispatcher(node,learned_clause,vtree->right,vtree_manager,nnf_manager,sat_state);
-    if(*learned_clause==NULL) *node = nnf_conjoin(*node,var2nnf(var,nnf_manager),nnf_manager);
+    if(*learned_clause==NULL) *node = unique_conjoin(*node,var2nnf(var,nnf_manager),nnf_manager);
     return;
   }
 
@@ -143,20 +171,20 @@ void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, DVtree* vtre
   if(!compile_with_literal(node,learned_clause,plit,vtree,vtree_manager,nnf_manager,sat_state)) return;
   assert(*learned_clause==NULL);
   assert(!sat_instantiated_var(var));
-  NNF_NODE pnode = *node; //save the node when conditioned on plit
+  NnfNode* pnode = *node; //save the node when conditioned on plit
 
   if(!compile_with_literal(node,learned_clause,nlit,vtree,vtree_manager,nnf_manager,sat_state)) return;
   assert(*learned_clause==NULL);
   assert(!sat_instantiated_var(var));
-  NNF_NODE nnode = *node; //save the node when conditioned on nlit
+  NnfNode* nnode = *node; //save the node when conditioned on nlit
 
   if(pnode==nnode) *node = pnode;
   else {
-    NNF_NODE pl  = nnf_literal2node(plit,nnf_manager);
-    NNF_NODE nl  = nnf_literal2node(nlit,nnf_manager);
-    NNF_NODE pc  = nnf_conjoin(pl,pnode,nnf_manager);
-    NNF_NODE nc  = nnf_conjoin(nl,nnode,nnf_manager);
-    *node        = nnf_disjoin(var,pc,nc,nnf_manager);
+    NnfNode* pl  = unique_literal(plit,nnf_manager);
+    NnfNode* nl  = unique_literal(nlit,nnf_manager);
+    NnfNode* pc  = unique_conjoin(pl,pnode,nnf_manager);
+    NnfNode* nc  = unique_conjoin(nl,nnode,nnf_manager);
+    *node        = unique_disjoin(var,pc,nc,nnf_manager);
   }
 }
 
@@ -164,11 +192,11 @@ void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, DVtree* vtre
  * Compiler dispatcher
  ******************************************************************************/
 
-void compile_dispatcher(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+void compile_dispatcher(NnfNode** node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, UniqueNnf* nnf_manager, SatState* sat_state) {
 
   //check cache
   VtreeCV item;
-  if(lookup_cache(&item,vtree,vtree_manager)) {
+  if(lookup_cache(&item,vtree,vtree_manager,sat_state)) {
     *node = item.node;
     *learned_clause = NULL;
     return;
@@ -185,7 +213,7 @@ void compile_dispatcher(NNF_NODE* node, Clause** learned_clause, DVtree* vtree,
   //cache if a node is returned
   if(*learned_clause==NULL) { //otherwise, a node has not been returned
     item.node = *node;
-    insert_cache(item,vtree,vtree_manager);
+    insert_cache(item,vtree,vtree_manager,sat_state);
   }
 }
  
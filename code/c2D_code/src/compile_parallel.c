@@ -0,0 +1,179 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+//compile.c
+NnfNode* compile_vtree_evidence(const c2dLiteral* evidence, c2dSize size, DVtree* vtree, VtreeManager* manager, UniqueNnf* nnf_manager, SatState* sat_state);
+//nnf_unique.c
+UniqueNnf* new_unique_nnf(const SatState* sat_state);
+void free_unique_nnf(UniqueNnf* nnf);
+NnfNode* unique_literal(const Lit* lit, const UniqueNnf* nnf);
+NnfNode* unique_conjoin(NnfNode* node1, NnfNode* node2, UniqueNnf* nnf);
+NnfNode* unique_disjoin(const Var* var, NnfNode* node1, NnfNode* node2, UniqueNnf* nnf);
+void save_unique_nnf(const char* fname, const NnfNode* root, const UniqueNnf* nnf, c2dSize* node_count, c2dSize* edge_count);
+//parallel.c
+VtreeTask* split_vtree_tasks(DVtree* root, c2dSize jobs, c2dSize* count);
+void free_vtree_tasks(VtreeTask* tasks, c2dSize count);
+void run_vtree_tasks(const VtreeTask* tasks, c2dSize count, c2dSize jobs, void (*run_task)(c2dSize index, c2dSize job, void* data), void* data);
+
+/******************************************************************************
+ * parallel compilation into a Decision-DNNF (see parallel.c)
+ *
+ * a task is compiled under its cube as evidence (see compile_vtree_evidence in compile.c)
+ * by a job, into the nodes of that job (see nnf_unique.c), and saved to its own nnf file.
+ * jobs cannot exchange nodes, so this process reads the nodes of all task files back into
+ * one UniqueNnf, where a sub-DNNF shared by several tasks becomes one node again, and
+ * combines split tasks there as compile_vtree_decomposed (a conjunction) and
+ * compile_vtree_shannon (a decision on the Shannon variable) do. the result is saved once
+ ******************************************************************************/
+
+typedef struct {
+  const VtreeTask* tasks;
+  const char* fname;    //nnf file of the whole cnf
+  VtreeManager* manager;
+  SatState* sat_state;
+} CompileJob;
+
+//nodes of a job (one UniqueNnf per job, as nnf nodes are cached across its tasks)
+static UniqueNnf* job_nnf = NULL;
+
+//returns the name of the nnf file of a task (to be freed by the caller)
+static char* task_file_name(const char* fname, c2dSize index) {
+  char* task_fname = (char*) malloc(strlen(fname)+32);
+  sprintf(task_fname,"%s.%"PRIvS"",fname,index);
+  return task_fname;
+}
+
+static void compile_task(c2dSize index, c2dSize job_index, void* data) {
+  CompileJob* job = (CompileJob*) data;
+  const VtreeTask* task = job->tasks+index;
+  if(job_nnf==NULL) job_nnf = new_unique_nnf(job->sat_state);
+
+  NnfNode* node = compile_vtree_evidence(task->cube,task->size,task->vtree,job->manager,job_nnf,job->sat_state);
+  char* task_fname = task_file_name(job->fname,index);
+  c2dSize n_count, e_count;
+  save_unique_nnf(task_fname,node,job_nnf,&n_count,&e_count);
+  free(task_fname);
+}
+
+/******************************************************************************
+ * merging nnf files
+ ******************************************************************************/
+
+static FILE* open_task_file(const char* fname, c2dSize index, c2dSize* n_count, c2dSize* e_count) {
+  char* task_fname = task_file_name(fname,index);
+  FILE* file = fopen(task_fname,"r");
+  c2dSize var_count;
+  if(file==NULL || fscanf(file," nnf %"PRIvS" %"PRIvS" %"PRIvS"",n_count,e_count,&var_count)!=3) {
+    fprintf(stderr,"\nc2D: cannot read nnf file %s\n",task_fname);
+    exit(1);
+  }
+  free(task_fname);
+  return file;
+}
+
+static void remove_task_file(const char* fname, c2dSize index) {
+  char* task_fname = task_file_name(fname,index);
+  remove(task_fname);
+  free(task_fname);
+}
+
+//returns the root of the nnf of a task file, after making its nodes in nnf
+//(nodes[i] is set to the node of line i of the file)
+static NnfNode* read_nnf_nodes(FILE* in, c2dSize n_count, NnfNode** nodes, UniqueNnf* nnf, SatState* sat_state) {
+  for(c2dSize i=0; i<n_count; i++) {
+    char type;
+    long var;
+    c2dSize size, child;
+    BOOLEAN ok = fscanf(in," %c",&type)==1;
+    if(ok && type=='L') {
+      ok = fscanf(in,"%ld",&var)==1 && var!=0 && (c2dSize)labs(var)<=nnf->var_count;
+      if(ok) nodes[i] = unique_literal(sat_index2literal(var,sat_state),nnf);
+    }
+    else if(ok && type=='A') {
+      ok = fscanf(in,"%"PRIvS"",&size)==1;
+      nodes[i] = nnf->one;
+      for(c2dSize j=0; ok && j<size; j++) {
+        ok = fscanf(in,"%"PRIvS"",&child)==1 && child<i;
+        if(ok) nodes[i] = unique_conjoin(nodes[i],nodes[child],nnf);
+      }
+    }
+    else if(ok && type=='O') {
+      ok = fscanf(in,"%ld %"PRIvS"",&var,&size)==2 && (size==0 || (size==2 && var>0 && (c2dSize)var<=nnf->var_count));
+      c2dSize children[2];
+      for(c2dSize j=0; ok && j<size; j++) ok = fscanf(in,"%"PRIvS"",children+j)==1 && children[j]<i;
+      if(ok) nodes[i] = size==0? nnf->zero: unique_disjoin(sat_index2var(var,sat_state),nodes[children[0]],nodes[children[1]],nnf);
+    }
+    else ok = 0;
+    if(!ok) {
+      fprintf(stderr,"\nc2D: malformed nnf file of a task\n");
+      exit(1);
+    }
+  }
+  return nodes[n_count-1];
+}
+
+//merge the nnf files of unsplit tasks into fname, and remove them
+static void merge_task_files(const char* fname, const VtreeTask* tasks, c2dSize count, c2dSize* n_count, c2dSize* e_count, SatState* sat_state) {
+  UniqueNnf* nnf  = new_unique_nnf(sat_state);
+  NnfNode** roots = (NnfNode**) malloc(count*sizeof(NnfNode*));
+  NnfNode** nodes = NULL;
+  c2dSize capacity = 0;
+
+  for(c2dSize i=0; i<count; i++) {
+    if(tasks[i].left!=0) continue;
+    c2dSize n, e;
+    FILE* in = open_task_file(fname,i,&n,&e);
+    if(n > capacity) {
+      capacity = n;
+      nodes    = (NnfNode**) realloc(nodes,capacity*sizeof(NnfNode*));
+    }
+    roots[i] = read_nnf_nodes(in,n,nodes,nnf,sat_state);
+    fclose(in);
+    remove_task_file(fname,i);
+  }
+  //subtasks come after their task
+  for(c2dSize i=count; i>0; i--) {
+    const VtreeTask* task = tasks+i-1;
+    if(task->left==0) continue;
+    NnfNode* l_root = roots[task->left];
+    NnfNode* r_root = roots[task->right];
+    if(vtree_is_shannon_node(task->vtree)) {
+      Var* var = vtree_shannon_var(task->vtree);
+      NnfNode* pc = unique_conjoin(unique_literal(sat_pos_literal(var),nnf),l_root,nnf);
+      NnfNode* nc = unique_conjoin(unique_literal(sat_neg_literal(var),nnf),r_root,nnf);
+      roots[i-1]  = unique_disjoin(var,pc,nc,nnf);
+    }
+    else roots[i-1] = unique_conjoin(l_root,r_root,nnf);
+  }
+  save_unique_nnf(fname,roots[0],nnf,n_count,e_count);
+
+  free_unique_nnf(nnf);
+  free(nodes);
+  free(roots);
+}
+
+/******************************************************************************
+ * main parallel compilation code
+ ******************************************************************************/
+
+//compile the cnf with jobs processes, saving the Decision-DNNF to fname
+//(its node and edge count are returned as in nnf_manager_save_to_file)
+void compile_vtree_parallel(c2dSize jobs, const char* fname, c2dSize* n_count, c2dSize* e_count, VtreeManager* manager, SatState* sat_state) {
+  c2dSize count;
+  VtreeTask* tasks = split_vtree_tasks(manager->vtree,jobs,&count);
+
+  CompileJob job = { tasks, fname, manager, sat_state };
+  run_vtree_tasks(tasks,count,jobs,compile_task,&job);
+  merge_task_files(fname,tasks,count,n_count,e_count,sat_state);
+
+  free_vtree_tasks(tasks,count);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
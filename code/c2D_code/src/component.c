@@ -0,0 +1,528 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _DEFAULT_SOURCE //shm_open, mmap and nanosleep
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "c2d.h"
+
+//parallel.c
+void* new_shared_memory(c2dSize bytes);
+void free_shared_memory(void* memory, c2dSize bytes);
+//utilities.c
+void pprint_bytes(const char* string, c2dSize bytes);
+HASHCODE cnf_fingerprint(const SatState* sat_state);
+
+/******************************************************************************
+ * sharing (weighted) model counts between vtree nodes
+ *
+ * the residual cnf at a vtree node is identified by its component key:
+ * --the sorted indices of input clauses that are not subsumed and that mention an
+ *   unassigned variable of the node, followed by
+ * --the sorted indices of the unassigned variables of the node
+ *
+ * the count at a vtree node is the count of its residual cnf times the weights of
+ * the assigned variables of the node. counts are stored divided by these weights,
+ * so a count computed at one vtree node can be reused at any node with the same
+ * component key (e.g., at an ancestor whose other variables are all assigned)
+ *
+ * the component table uses open addressing (linear probing). entries are never
+ * removed: an entry is stale once the vtree node that computed it has its cache
+ * entries dropped (see epochs in cache.c), and stale entries are left behind when
+ * the table grows
+ *
+ * the table is also used when counting by dynamic decomposition (see count_dynamic.c),
+ * where components are given as sets of unassigned variables and entries never go stale
+ *
+ * when jobs count in parallel (see parallel.c), they use one table in shared memory
+ * instead (see share_component_cache), which may also be shared by c2D processes
+ * counting the same cnf (see open_component_segment)
+ ******************************************************************************/
+
+//the table grows when count > MAX_LOAD_NUM/MAX_LOAD_DEN of capacity
+#define MAX_LOAD_NUM 1
+#define MAX_LOAD_DEN 2
+
+#define INITIAL_CAPACITY 4096
+
+//multiplier for fibonacci hashing (2^64 divided by the golden ratio)
+#define FIB_HASH 11400714819323198485UL
+
+static inline c2dSize component_slot(HASHCODE hashcode, const ComponentCache* components) {
+  return (c2dSize)((hashcode*FIB_HASH)>>components->shift);
+}
+
+//cache is NULL when components are not computed at vtree nodes
+static inline BOOLEAN stale_component(const ComponentCE* entry, const VtreeCache* cache) {
+  return cache!=NULL && entry->epoch!=cache->nodes[entry->position].epoch;
+}
+
+/******************************************************************************
+ * constructing and freeing the component table
+ ******************************************************************************/
+
+static void allocate_component_slots(c2dSize capacity, ComponentCache* components) {
+  c2dSize log = 0;
+  while(((c2dSize)1<<log) < capacity) ++log;
+
+  components->capacity = (c2dSize)1<<log;
+  components->shift    = 8*sizeof(HASHCODE)-log;
+  components->slots    = (ComponentCE*) calloc(components->capacity,sizeof(ComponentCE));
+}
+
+ComponentCache* construct_component_cache() {
+  ComponentCache* components = (ComponentCache*) malloc(sizeof(ComponentCache));
+
+  allocate_component_slots(INITIAL_CAPACITY,components);
+  components->count        = 0;
+  components->memory       = 0;
+  components->hits         = 0;
+  components->shared_hits  = 0;
+  components->misses       = 0;
+  components->decisions    = 0;
+  components->key          = NULL;
+  components->key_capacity = 0;
+  components->shared       = NULL;
+  components->first_stats  = 0;
+  components->job_count    = 0;
+  components->job          = 0;
+  return components;
+}
+
+void free_component_cache(ComponentCache* components) {
+  for(c2dSize i=0; i<components->capacity; i++) free(components->slots[i].key);
+  free(components->slots);
+  free(components->key);
+  if(components->shared!=NULL) free_shared_memory(components->shared,components->shared->bytes);
+  free(components);
+}
+
+//double the number of slots, leaving stale entries behind
+static void grow_component_cache(const VtreeCache* cache, ComponentCache* components) {
+  c2dSize old_capacity  = components->capacity;
+  ComponentCE* old_slots = components->slots;
+
+  allocate_component_slots(2*old_capacity,components);
+  components->count = 0;
+  c2dSize mask = components->capacity-1;
+  for(c2dSize i=0; i<old_capacity; i++) {
+    ComponentCE* entry = old_slots+i;
+    if(entry->key==NULL) continue;
+    if(stale_component(entry,cache)) {
+      components->memory -= entry->size*sizeof(c2dSize);
+      free(entry->key);
+      continue;
+    }
+    c2dSize j = component_slot(entry->hashcode,components);
+    while(components->slots[j].key!=NULL) j = (j+1)&mask;
+    components->slots[j] = *entry;
+    ++components->count;
+  }
+
+  free(old_slots);
+}
+
+/******************************************************************************
+ * constructing component keys
+ ******************************************************************************/
+
+static int compare_indices(const void* a, const void* b) {
+  c2dSize x = *(const c2dSize*)a;
+  c2dSize y = *(const c2dSize*)b;
+  return x<y? -1: x>y;
+}
+
+static void push_index(c2dSize index, ComponentCache* components) {
+  if(components->size==components->key_capacity) {
+    components->key_capacity = components->key_capacity? 2*components->key_capacity: 1024;
+    components->key = (c2dSize*) realloc(components->key,components->key_capacity*sizeof(c2dSize));
+  }
+  components->key[components->size++] = index;
+}
+
+//add the unassigned variables of vtree to the key, and multiply weight by the
+//weights of its assigned variables
+static void collect_vars(DVtree* vtree, c2dWmc* weight, ComponentCache* components) {
+  if(vtree->left!=NULL) {
+    collect_vars(vtree->left,weight,components);
+    collect_vars(vtree->right,weight,components);
+    return;
+  }
+  Lit* plit = sat_pos_literal(vtree->var);
+  Lit* nlit = sat_neg_literal(vtree->var);
+  if(sat_implied_literal(plit))      *weight *= sat_literal_weight(plit);
+  else if(sat_implied_literal(nlit)) *weight *= sat_literal_weight(nlit);
+  else push_index(sat_var_index(vtree->var),components);
+}
+
+//complete the component key whose unassigned variables have been added: the number
+//of unassigned variables, followed by their sorted indices, followed by the sorted 
+//indices of clauses that mention them (the key, its size and hash code are set in components)
+static void close_component_key(const SatState* sat_state, ComponentCache* components) {
+  c2dSize var_count = components->size-1;
+  components->key[0] = var_count;
+
+  //input clauses come first in the clause list of a variable
+  c2dSize input_count = sat_clause_count(sat_state);
+  for(c2dSize i=1; i<=var_count; i++) {
+    Var* var = sat_index2var(components->key[i],sat_state);
+    Clause* clause;
+    for(c2dSize j=0; (clause=sat_clause_of_var(j,var))!=NULL; j++) {
+      if(sat_clause_index(clause) > input_count) break;
+      if(sat_subsumed_clause(clause) || sat_marked_clause(clause)) continue;
+      sat_mark_clause(clause);
+      push_index(sat_clause_index(clause),components);
+    }
+  }
+  for(c2dSize i=1+var_count; i<components->size; i++) 
+    sat_unmark_clause(sat_index2clause(components->key[i],sat_state));
+
+  qsort(components->key+1,var_count,sizeof(c2dSize),compare_indices);
+  qsort(components->key+1+var_count,components->size-1-var_count,sizeof(c2dSize),compare_indices);
+
+  HASHCODE hashcode = components->size;
+  for(c2dSize i=0; i<components->size; i++) {
+    hashcode = (hashcode^components->key[i])*0x9E3779B97F4A7C15UL;
+    hashcode ^= hashcode>>32;
+  }
+  components->hashcode = hashcode;
+}
+
+//construct the component key of vtree, and the weight of its assigned variables
+static void construct_component_key(DVtree* vtree, const SatState* sat_state, ComponentCache* components) {
+  components->size   = 0;
+  components->weight = 1;
+  push_index(0,components); //number of variables (set by close_component_key)
+  collect_vars(vtree,&components->weight,components);
+  close_component_key(sat_state,components);
+}
+
+//construct the component key of a set of unassigned variables (given by their indices)
+static void construct_vars_component_key(const c2dSize* vars, c2dSize var_count, const SatState* sat_state, ComponentCache* components) {
+  components->size   = 0;
+  components->weight = 1;
+  push_index(0,components); //number of variables (set by close_component_key)
+  for(c2dSize i=0; i<var_count; i++) push_index(vars[i],components);
+  close_component_key(sat_state,components);
+}
+
+/******************************************************************************
+ * the component table shared by parallel jobs, or by c2D processes on the same cnf
+ *
+ * the table has a fixed capacity: inserts are dropped once it is half full or its key
+ * arena is exhausted. its entries never go stale, since the count of a residual cnf
+ * does not depend on the vtree node (or job, or process) that computed it
+ *
+ * lookups take no locks. a job copies a key to cells of the arena that it reserves
+ * with a fetch-and-add, claims an empty slot with a compare-and-swap of its state,
+ * writes the entry, and then publishes it (a release store of its state). lookups
+ * only compare entries that are published (acquire loads), and skip slots that are
+ * being written. hence, a job may miss an entry that is being written by another,
+ * and two jobs may insert the same key (costing a slot but not correctness)
+ *
+ * the table refers to its parts by offsets, so it can live in a named segment of
+ * shared memory that processes map at different addresses (see open_component_segment).
+ * the segment is tagged with a fingerprint of the cnf, as component keys are indices
+ * of its clauses and variables
+ *
+ * each job counts its lookups in its own stats, which are merged when printed
+ ******************************************************************************/
+
+#define SHARED_EMPTY   0
+#define SHARED_WRITING 1
+#define SHARED_READY   2
+
+#define SHARED_MAGIC     0x63324453484152UL //"c2DSHAR"
+#define SHARED_CAPACITY  (1UL<<21) //slots
+#define SHARED_KEY_CELLS (1UL<<24) //cells of the key arena
+#define SHARED_STATS     1024      //stats of jobs (of all processes sharing a segment)
+
+//time to wait for another process to initialize a segment
+#define SEGMENT_WAIT_MS  10000
+
+static inline SharedComponentCS* shared_slots(const SharedComponentCache* shared) {
+  return (SharedComponentCS*) ((BYTE*)shared+shared->slots);
+}
+
+static inline c2dSize* shared_keys(const SharedComponentCache* shared) {
+  return (c2dSize*) ((BYTE*)shared+shared->keys);
+}
+
+static inline SharedComponentStats* shared_stats(const SharedComponentCache* shared, c2dSize index) {
+  return (SharedComponentStats*) ((BYTE*)shared+shared->stats)+index%shared->stats_capacity;
+}
+
+//the size of a shared table (its memory is only touched as it fills up)
+static c2dSize shared_table_bytes() {
+  return sizeof(SharedComponentCache)+SHARED_STATS*sizeof(SharedComponentStats)+
+         SHARED_CAPACITY*sizeof(SharedComponentCS)+SHARED_KEY_CELLS*sizeof(c2dSize);
+}
+
+//lay out a table in zeroed shared memory, and tag it as initialized
+static void initialize_shared_table(SharedComponentCache* shared, HASHCODE cnf) {
+  shared->cnf            = cnf;
+  shared->bytes          = shared_table_bytes();
+  shared->capacity       = SHARED_CAPACITY;
+  shared->shift          = 8*sizeof(HASHCODE)-__builtin_ctzl(SHARED_CAPACITY);
+  shared->stats          = sizeof(SharedComponentCache);
+  shared->stats_capacity = SHARED_STATS;
+  shared->slots          = shared->stats+SHARED_STATS*sizeof(SharedComponentStats);
+  shared->keys           = shared->slots+SHARED_CAPACITY*sizeof(SharedComponentCS);
+  shared->key_capacity   = SHARED_KEY_CELLS;
+  //the remaining fields are 0
+  __atomic_store_n(&shared->magic,SHARED_MAGIC,__ATOMIC_RELEASE);
+}
+
+//use shared for the jobs of this process, claiming stats for them
+static void attach_shared_table(SharedComponentCache* shared, c2dSize jobs, ComponentCache* components) {
+  components->shared      = shared;
+  components->first_stats = __atomic_fetch_add(&shared->stats_used,jobs,__ATOMIC_RELAXED);
+  components->job_count   = jobs;
+  components->job         = 0;
+}
+
+//allocate a shared table for jobs, to be used by their copies of components
+void share_component_cache(c2dSize jobs, ComponentCache* components) {
+  SharedComponentCache* shared = (SharedComponentCache*) new_shared_memory(shared_table_bytes());
+  initialize_shared_table(shared,0);
+  attach_shared_table(shared,jobs,components);
+}
+
+static void segment_error(const char* name, const char* error) {
+  fprintf(stderr,"\nc2D: shared memory segment %s %s\n",name,error);
+  exit(1);
+}
+
+static void wait_a_millisecond() {
+  struct timespec delay = { 0, 1000000 };
+  nanosleep(&delay,NULL);
+}
+
+//use the table in the shared memory segment name (e.g., "/c2d"), which is created 
+//if it does not exist, for the jobs of this process. the segment outlives the process
+//(it is removed by shm_unlink, or from /dev/shm)
+void open_component_segment(const char* name, c2dSize jobs, const SatState* sat_state, ComponentCache* components) {
+  c2dSize bytes = shared_table_bytes();
+  HASHCODE cnf  = cnf_fingerprint(sat_state);
+
+  int fd = shm_open(name,O_RDWR|O_CREAT|O_EXCL,0600);
+  BOOLEAN creator = fd>=0;
+  if(creator) {
+    if(ftruncate(fd,bytes)!=0) segment_error(name,"cannot be sized");
+  }
+  else {
+    fd = shm_open(name,O_RDWR,0600);
+    if(fd<0) segment_error(name,"cannot be opened");
+    //the creator may not have sized it yet
+    struct stat status;
+    for(int ms=0; fstat(fd,&status)==0 && (c2dSize)status.st_size!=bytes; ms++) {
+      if(ms==SEGMENT_WAIT_MS) segment_error(name,"has the wrong size (created by another version of c2D?)");
+      wait_a_millisecond();
+    }
+  }
+
+  SharedComponentCache* shared = (SharedComponentCache*) mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  close(fd);
+  if(shared==MAP_FAILED) segment_error(name,"cannot be mapped");
+
+  if(creator) initialize_shared_table(shared,cnf);
+  else {
+    for(int ms=0; __atomic_load_n(&shared->magic,__ATOMIC_ACQUIRE)!=SHARED_MAGIC; ms++) {
+      if(ms==SEGMENT_WAIT_MS) segment_error(name,"was not initialized");
+      wait_a_millisecond();
+    }
+    if(shared->cnf!=cnf) segment_error(name,"holds the components of another cnf");
+  }
+  attach_shared_table(shared,jobs,components);
+}
+
+//return 1 if the key in components has an entry in the shared table (setting count)
+static BOOLEAN find_shared_component(c2dWmc* count, ComponentCache* components) {
+  SharedComponentCache* shared = components->shared;
+  SharedComponentStats* stats  = shared_stats(shared,components->first_stats+components->job);
+  SharedComponentCS* slots     = shared_slots(shared);
+  c2dSize* keys = shared_keys(shared);
+  c2dSize mask  = shared->capacity-1;
+  c2dSize index = (c2dSize)((components->hashcode*FIB_HASH)>>shared->shift);
+  for(c2dSize probes=0; probes<shared->capacity; probes++) {
+    SharedComponentCS* slot = slots+index;
+    unsigned int state = __atomic_load_n(&slot->state,__ATOMIC_ACQUIRE);
+    if(state==SHARED_EMPTY) break;
+    if(state==SHARED_READY && slot->hashcode==components->hashcode && slot->size==components->size &&
+       !memcmp(keys+slot->key,components->key,components->size*sizeof(c2dSize))) {
+      ++stats->hits;
+      *count = slot->count;
+      return 1;
+    }
+    index = (index+1)&mask;
+  }
+  ++stats->misses;
+  return 0;
+}
+
+//map the key in components to count in the shared table (normalized by the weight in components)
+static void store_shared_component(c2dWmc count, ComponentCache* components) {
+  if(components->weight==0) return; //count cannot be normalized
+  SharedComponentCache* shared = components->shared;
+  SharedComponentStats* stats  = shared_stats(shared,components->first_stats+components->job);
+  SharedComponentCS* slots     = shared_slots(shared);
+  c2dSize* keys = shared_keys(shared);
+
+  if(MAX_LOAD_DEN*__atomic_load_n(&shared->count,__ATOMIC_RELAXED) >= MAX_LOAD_NUM*shared->capacity) {
+    ++stats->drops;
+    return;
+  }
+  c2dSize key = __atomic_fetch_add(&shared->key_used,components->size,__ATOMIC_RELAXED);
+  if(key+components->size > shared->key_capacity) {
+    ++stats->drops;
+    return;
+  }
+  memcpy(keys+key,components->key,components->size*sizeof(c2dSize));
+
+  c2dSize mask  = shared->capacity-1;
+  c2dSize index = (c2dSize)((components->hashcode*FIB_HASH)>>shared->shift);
+  for(c2dSize probes=0; probes<shared->capacity; probes++) {
+    SharedComponentCS* slot = slots+index;
+    unsigned int state = SHARED_EMPTY;
+    if(__atomic_compare_exchange_n(&slot->state,&state,SHARED_WRITING,0,__ATOMIC_ACQUIRE,__ATOMIC_ACQUIRE)) {
+      slot->size     = components->size;
+      slot->hashcode = components->hashcode;
+      slot->count    = count/components->weight;
+      slot->key      = key;
+      __atomic_store_n(&slot->state,SHARED_READY,__ATOMIC_RELEASE);
+      __atomic_fetch_add(&shared->count,1,__ATOMIC_RELAXED);
+      return;
+    }
+    //state is now that of the slot: a published entry with the same key has the same count
+    if(state==SHARED_READY && slot->hashcode==components->hashcode && slot->size==components->size &&
+       !memcmp(keys+slot->key,components->key,components->size*sizeof(c2dSize))) return;
+    index = (index+1)&mask;
+  }
+  ++stats->drops;
+}
+
+/******************************************************************************
+ * lookup and insert
+ ******************************************************************************/
+
+//return the entry whose key is the key in components (NULL if there is none)
+static ComponentCE* find_component(const VtreeCache* cache, ComponentCache* components) {
+  c2dSize mask  = components->capacity-1;
+  c2dSize index = component_slot(components->hashcode,components);
+  for(ComponentCE* entry=components->slots+index; entry->key!=NULL; entry=components->slots+index) {
+    if(entry->hashcode==components->hashcode && entry->size==components->size &&
+       !memcmp(entry->key,components->key,components->size*sizeof(c2dSize)) && 
+       !stale_component(entry,cache)) {
+      ++components->hits;
+      return entry;
+    }
+    index = (index+1)&mask;
+  }
+  ++components->misses;
+  return NULL;
+}
+
+//map the key in components to count (normalized by the weight in components)
+static void store_component(c2dWmc count, c2dSize position, unsigned int epoch, const VtreeCache* cache, ComponentCache* components) {
+  if(components->weight==0) return; //count cannot be normalized
+
+  if(MAX_LOAD_DEN*(components->count+1) > MAX_LOAD_NUM*components->capacity) 
+    grow_component_cache(cache,components);
+
+  c2dSize mask  = components->capacity-1;
+  c2dSize index = component_slot(components->hashcode,components);
+  ComponentCE* entry = components->slots+index;
+  //an entry with the same key is stale or has the same count: reuse its slot
+  while(entry->key!=NULL) {
+    if(entry->hashcode==components->hashcode && entry->size==components->size &&
+       !memcmp(entry->key,components->key,components->size*sizeof(c2dSize))) break;
+    index = (index+1)&mask;
+    entry = components->slots+index;
+  }
+  if(entry->key==NULL) {
+    entry->key = (c2dSize*) malloc(components->size*sizeof(c2dSize));
+    memcpy(entry->key,components->key,components->size*sizeof(c2dSize));
+    entry->hashcode = components->hashcode;
+    entry->size     = components->size;
+    ++components->count;
+    components->memory += components->size*sizeof(c2dSize);
+  }
+  entry->count    = count/components->weight;
+  entry->position = position;
+  entry->epoch    = epoch;
+}
+
+//return 1 if the residual cnf of vtree has a count in the component table, 0 otherwise
+//if lookup is successful, set count accordingly
+BOOLEAN lookup_component(c2dWmc* count, DVtree* vtree, const VtreeCache* cache, const SatState* sat_state) {
+  ComponentCache* components = cache->components;
+  construct_component_key(vtree,sat_state,components);
+  if(components->shared!=NULL) {
+    if(!find_shared_component(count,components)) return 0;
+    *count *= components->weight;
+    return 1;
+  }
+  ComponentCE* entry = find_component(cache,components);
+  if(entry==NULL) return 0;
+  if(entry->position!=vtree->position) ++components->shared_hits;
+  *count = entry->count*components->weight;
+  return 1;
+}
+
+//insert the count of vtree into the component table 
+//(the state of the sat solver is assumed to be the one in which count was computed)
+void insert_component(c2dWmc count, DVtree* vtree, const VtreeCache* cache, const SatState* sat_state) {
+  construct_component_key(vtree,sat_state,cache->components);
+  if(cache->components->shared!=NULL) store_shared_component(count,cache->components);
+  else store_component(count,vtree->position,cache->nodes[vtree->position].epoch,cache,cache->components);
+}
+
+//lookup and insert for components given as sets of unassigned variables
+BOOLEAN lookup_vars_component(c2dWmc* count, const c2dSize* vars, c2dSize var_count, const SatState* sat_state, ComponentCache* components) {
+  construct_vars_component_key(vars,var_count,sat_state,components);
+  if(components->shared!=NULL) return find_shared_component(count,components);
+  ComponentCE* entry = find_component(NULL,components);
+  if(entry==NULL) return 0;
+  *count = entry->count;
+  return 1;
+}
+
+void insert_vars_component(c2dWmc count, const c2dSize* vars, c2dSize var_count, const SatState* sat_state, ComponentCache* components) {
+  construct_vars_component_key(vars,var_count,sat_state,components);
+  if(components->shared!=NULL) store_shared_component(count,components);
+  else store_component(count,0,0,NULL,components);
+}
+
+/******************************************************************************
+ * stats
+ ******************************************************************************/
+
+void print_component_cache_stats(const ComponentCache* components) {
+  const SharedComponentCache* shared = components->shared;
+  if(shared!=NULL) { //merge the stats of jobs
+    SharedComponentStats total = {0,0,0};
+    for(c2dSize j=0; j<components->job_count; j++) {
+      SharedComponentStats* stats = shared_stats(shared,components->first_stats+j);
+      total.hits   += stats->hits;
+      total.misses += stats->misses;
+      total.drops  += stats->drops;
+    }
+    printf(     "\n  components \t%"PRIvS" hits, %"PRIvS" misses, %"PRIvS" dropped, %"PRIvS" entries (shared)",
+                total.hits,total.misses,total.drops,shared->count);
+    pprint_bytes(", ",shared->count*sizeof(SharedComponentCS)+(shared->key_used<shared->key_capacity? shared->key_used: shared->key_capacity)*sizeof(c2dSize));
+    return;
+  }
+  printf(     "\n  components \t%"PRIvS" hits (%"PRIvS" from other vtree nodes), %"PRIvS" misses, %"PRIvS" entries",
+              components->hits,components->shared_hits,components->misses,components->count);
+  pprint_bytes(", ",components->memory+components->capacity*sizeof(ComponentCE));
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,220 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+//component.c
+BOOLEAN lookup_vars_component(c2dWmc* count, const c2dSize* vars, c2dSize var_count, const SatState* sat_state, ComponentCache* components);
+void insert_vars_component(c2dWmc count, const c2dSize* vars, c2dSize var_count, const SatState* sat_state, ComponentCache* components);
+//utilities.c
+void pprint_bytes(const char* string, c2dSize bytes);
+
+//local
+static void count_vars(c2dWmc* count, Clause** learned_clause, const c2dSize* vars, c2dSize var_count, ComponentCache* components, SatState* sat_state);
+
+/******************************************************************************
+ * (weighted) model counting by dynamic decomposition (no vtree is used)
+ *
+ * a set of variables is counted by multiplying the weights of its assigned variables
+ * with the counts of the components of its unassigned variables, where a component
+ * is a set of unassigned variables connected by unsubsumed input clauses
+ *
+ * a component is counted by case analysis on its variable that appears in the most
+ * unsubsumed clauses, after which its variables are counted as a set (and hence split
+ * into components again). counts of components are cached by component key (see
+ * component.c)
+ *
+ * learned clauses are handled as in count.c: counting is aborted and resumes at the
+ * assertion level of the learned clause. after asserting a learned clause, variables
+ * of components that are still to be counted may be assigned, in which case they are
+ * counted as a set
+ ******************************************************************************/
+
+c2dWmc count_dynamic(ComponentCache* components, SatState* sat_state) {
+
+  c2dWmc count;
+  Clause* learned_clause = NULL;
+
+  if(sat_unit_resolution(sat_state)) { //unit resolution succeeded
+    c2dSize var_count = sat_var_count(sat_state);
+    c2dSize* vars     = (c2dSize*) malloc(var_count*sizeof(c2dSize));
+    for(c2dSize i=0; i<var_count; i++) vars[i] = i+1;
+    count_vars(&count,&learned_clause,vars,var_count,components,sat_state);
+    if(learned_clause!=NULL) count = 0; //cnf is inconsistent
+    free(vars);
+  }
+  else count = 0; //cnf is inconsistent
+
+  sat_undo_unit_resolution(sat_state);
+  return count;
+}
+
+/******************************************************************************
+ * splitting unassigned variables into components
+ ******************************************************************************/
+
+//permute vars so that each component occupies a contiguous block, and return the
+//number of components (component i is vars[starts[i]], ..., vars[starts[i+1]-1])
+//vars are assumed unassigned and not connected to other unassigned variables
+static c2dSize split_components(c2dSize* vars, c2dSize var_count, c2dSize* starts, const SatState* sat_state) {
+  c2dSize* queue = (c2dSize*) malloc(var_count*sizeof(c2dSize));
+  c2dSize input_count = sat_clause_count(sat_state);
+
+  //a marked variable is in vars and has not been reached yet
+  for(c2dSize i=0; i<var_count; i++) sat_mark_var(sat_index2var(vars[i],sat_state));
+
+  c2dSize count = 0; //components
+  c2dSize size  = 0; //variables in queue
+  for(c2dSize i=0; i<var_count; i++) {
+    Var* var = sat_index2var(vars[i],sat_state);
+    if(!sat_marked_var(var)) continue; //in an earlier component
+    starts[count++] = size;
+    sat_unmark_var(var);
+    queue[size++] = vars[i];
+    for(c2dSize q=starts[count-1]; q<size; q++) {
+      Var* u = sat_index2var(queue[q],sat_state);
+      Clause* clause;
+      //input clauses come first in the clause list of a variable
+      for(c2dSize j=0; (clause=sat_clause_of_var(j,u))!=NULL; j++) {
+        if(sat_clause_index(clause) > input_count) break;
+        if(sat_subsumed_clause(clause)) continue;
+        Lit** literals = sat_clause_literals(clause);
+        for(c2dSize k=0; k<sat_clause_size(clause); k++) {
+          Var* w = sat_literal_var(literals[k]);
+          if(sat_marked_var(w)) {
+            sat_unmark_var(w);
+            queue[size++] = sat_var_index(w);
+          }
+        }
+      }
+    }
+  }
+  starts[count] = size;
+  assert(size==var_count);
+
+  memcpy(vars,queue,var_count*sizeof(c2dSize));
+  free(queue);
+  return count;
+}
+
+//return the variable of vars that appears in the most unsubsumed input clauses
+static Var* decision_var(const c2dSize* vars, c2dSize var_count, const SatState* sat_state) {
+  c2dSize input_count = sat_clause_count(sat_state);
+  Var* best         = NULL;
+  c2dSize best_occs = 0;
+  for(c2dSize i=0; i<var_count; i++) {
+    Var* var = sat_index2var(vars[i],sat_state);
+    c2dSize occs = 0;
+    Clause* clause;
+    for(c2dSize j=0; (clause=sat_clause_of_var(j,var))!=NULL; j++) {
+      if(sat_clause_index(clause) > input_count) break;
+      if(!sat_subsumed_clause(clause)) ++occs;
+    }
+    if(best==NULL || occs > best_occs) {
+      best      = var;
+      best_occs = occs;
+    }
+  }
+  return best;
+}
+
+/******************************************************************************
+ * counting components
+ ******************************************************************************/
+
+static void count_component(c2dWmc* count, Clause** learned_clause, const c2dSize* vars, c2dSize var_count, ComponentCache* components, SatState* sat_state);
+
+static inline
+BOOLEAN count_with_literal(c2dWmc* count, Clause** learned_clause, Lit* literal, const c2dSize* vars, c2dSize var_count, ComponentCache* components, SatState* sat_state) {
+  ++components->decisions;
+  *learned_clause = sat_decide_literal(literal,sat_state);
+  if(*learned_clause==NULL) count_vars(count,learned_clause,vars,var_count,components,sat_state);
+  sat_undo_decide_literal(sat_state);
+  if(*learned_clause!=NULL) { //a clause was learned
+    if(sat_at_assertion_level(*learned_clause,sat_state)) {
+      *learned_clause = sat_assert_clause(*learned_clause,sat_state);
+      //if another clause was not learned, then we are ready to try the component again
+      if(*learned_clause==NULL) count_component(count,learned_clause,vars,var_count,components,sat_state);
+    }
+    return 0; //counting with literal failed as it led to learning at least one clause
+  }
+  else return 1; //counting with literal succeeded without learning clauses
+}
+
+static void count_component(c2dWmc* count, Clause** learned_clause, const c2dSize* vars, c2dSize var_count, ComponentCache* components, SatState* sat_state) {
+  //a learned clause may have assigned variables of the component
+  for(c2dSize i=0; i<var_count; i++) {
+    if(sat_instantiated_var(sat_index2var(vars[i],sat_state))) {
+      count_vars(count,learned_clause,vars,var_count,components,sat_state);
+      return;
+    }
+  }
+
+  *learned_clause = NULL;
+  if(var_count==1) { //the variable appears in no unsubsumed clause
+    Var* var = sat_index2var(vars[0],sat_state);
+    *count = sat_literal_weight(sat_pos_literal(var)) + sat_literal_weight(sat_neg_literal(var));
+    return;
+  }
+  if(lookup_vars_component(count,vars,var_count,sat_state,components)) return;
+
+  Var* var  = decision_var(vars,var_count,sat_state);
+  Lit* plit = sat_pos_literal(var);
+  Lit* nlit = sat_neg_literal(var);
+
+  if(!count_with_literal(count,learned_clause,plit,vars,var_count,components,sat_state)) return;
+  c2dWmc pcount = *count; //count conditioned on plit (including its weight)
+
+  if(!count_with_literal(count,learned_clause,nlit,vars,var_count,components,sat_state)) return;
+  c2dWmc ncount = *count; //count conditioned on nlit (including its weight)
+
+  *count = pcount + ncount;
+  insert_vars_component(*count,vars,var_count,sat_state,components);
+}
+
+static void count_vars(c2dWmc* count, Clause** learned_clause, const c2dSize* vars, c2dSize var_count, ComponentCache* components, SatState* sat_state) {
+  c2dSize* free_vars = (c2dSize*) malloc((2*var_count+1)*sizeof(c2dSize));
+  c2dSize* starts    = free_vars+var_count;
+  c2dSize free_count = 0;
+
+  *count = 1;
+  *learned_clause = NULL;
+  for(c2dSize i=0; i<var_count; i++) {
+    Var* var  = sat_index2var(vars[i],sat_state);
+    Lit* plit = sat_pos_literal(var);
+    Lit* nlit = sat_neg_literal(var);
+    if(sat_implied_literal(plit))      *count *= sat_literal_weight(plit);
+    else if(sat_implied_literal(nlit)) *count *= sat_literal_weight(nlit);
+    else free_vars[free_count++] = vars[i];
+  }
+
+  c2dSize component_count = split_components(free_vars,free_count,starts,sat_state);
+  for(c2dSize i=0; i<component_count && *count!=0; i++) {
+    c2dWmc component;
+    count_component(&component,learned_clause,free_vars+starts[i],starts[i+1]-starts[i],components,sat_state);
+    if(*learned_clause!=NULL) break;
+    *count *= component;
+  }
+
+  free(free_vars);
+}
+
+/******************************************************************************
+ * stats
+ ******************************************************************************/
+
+void print_dynamic_stats(const ComponentCache* components) {
+  printf("\nDynamic decomposition stats:");
+  printf(     "\n  decisions  \t%"PRIvS"",components->decisions);
+  printf(     "\n  hit rate   \t%.1f%%",(100.0*components->hits)/(components->hits+components->misses));
+  printf(     "\n  lookups    \t%"PRIvS"",components->hits+components->misses);
+  printf(     "\n  components \t%"PRIvS"",components->count);
+  pprint_bytes("\n  memory     \t",components->memory+components->capacity*sizeof(ComponentCE));
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
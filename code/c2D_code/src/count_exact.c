@@ -0,0 +1,288 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include <gmp.h>
+#include "c2d.h"
+
+//cache.c
+void* new_count_cells(c2dSize size, VtreeCache* cache);
+void set_vtree_cache_counts(VtreeCountCells count_cells, void* counts, VtreeCache* cache);
+
+/******************************************************************************
+ * exact (weighted) model counting: literal weights must be nonnegative integers
+ *
+ * counts are kept as 128-bit integers while they fit, and switch to GMP integers
+ * only once they do not. a larger count being computed is held by a scratch GMP
+ * integer, which is reused once the count is consumed (by a product or a Shannon
+ * sum) or discarded, so GMP integers are not initialized for each operation
+ *
+ * a cached count takes one word: a count below 2^63 is stored inline (tagged by a
+ * lowest bit of 1), and a larger count as a pointer to its limbs in the arena of
+ * counts (see cache.c). a cached count is copied into a scratch integer when looked
+ * up, as the arena may be compacted while the count is used
+ ******************************************************************************/
+
+typedef unsigned __int128 c2dWide;
+
+typedef struct {
+  c2dWide small; //the count if big is 0
+  c2dSize big;   //otherwise, 1+the index of the scratch integer holding the count
+} ExactCount;
+
+//scratch integers (the state of exact counts, see count_kernel.h)
+typedef struct {
+  mpz_t* values;
+  c2dSize count;    //values initialized
+  c2dSize* free;    //indices of values that hold no count
+  c2dSize free_count;
+  mpz_t x, y;       //operands converted from 128-bit counts
+} ExactScratch;
+
+#define LIMB_BITS (8*sizeof(c2dSize))
+
+static inline c2dSize literal_weight(Lit* lit) {
+  return (c2dSize)sat_literal_weight(lit);
+}
+
+static inline ExactScratch* exact_scratch(VtreeManager* manager) {
+  return (ExactScratch*) manager->cache->counts;
+}
+
+/******************************************************************************
+ * scratch integers
+ ******************************************************************************/
+
+static ExactScratch* new_exact_scratch() {
+  ExactScratch* scratch = (ExactScratch*) malloc(sizeof(ExactScratch));
+  scratch->values     = NULL;
+  scratch->count      = 0;
+  scratch->free       = NULL;
+  scratch->free_count = 0;
+  mpz_init(scratch->x);
+  mpz_init(scratch->y);
+  return scratch;
+}
+
+static void free_exact_scratch(ExactScratch* scratch) {
+  for(c2dSize i=0; i<scratch->count; i++) mpz_clear(scratch->values[i]);
+  mpz_clear(scratch->x);
+  mpz_clear(scratch->y);
+  free(scratch->values);
+  free(scratch->free);
+  free(scratch);
+}
+
+//returns 1+the index of a scratch integer that holds no count
+static c2dSize claim_scratch(ExactScratch* scratch) {
+  if(scratch->free_count) return 1+scratch->free[--scratch->free_count];
+  //values only move here, so counts refer to them by index
+  scratch->values = (mpz_t*) realloc(scratch->values,(scratch->count+1)*sizeof(mpz_t));
+  scratch->free   = (c2dSize*) realloc(scratch->free,(scratch->count+1)*sizeof(c2dSize));
+  mpz_init(scratch->values[scratch->count]);
+  return ++scratch->count;
+}
+
+static inline void release_scratch(ExactCount* count, ExactScratch* scratch) {
+  if(count->big) scratch->free[scratch->free_count++] = count->big-1;
+  count->big = 0;
+}
+
+static inline mpz_ptr scratch_value(c2dSize big, ExactScratch* scratch) {
+  return scratch->values[big-1];
+}
+
+/******************************************************************************
+ * converting counts from/to GMP integers
+ ******************************************************************************/
+
+static void wide2mpz(mpz_t z, c2dWide value) {
+  c2dSize limbs[2] = { (c2dSize)value, (c2dSize)(value>>LIMB_BITS) };
+  mpz_import(z,2,-1,sizeof(c2dSize),0,0,limbs);
+}
+
+//returns the GMP integer of count (z if the count is a 128-bit integer)
+static mpz_srcptr exact2mpz(mpz_t z, const ExactCount* count, ExactScratch* scratch) {
+  if(count->big) return scratch_value(count->big,scratch);
+  wide2mpz(z,count->small);
+  return z;
+}
+
+//a count held by a scratch integer becomes a 128-bit integer if it fits
+static void settle_exact(ExactCount* count, ExactScratch* scratch) {
+  mpz_srcptr z = scratch_value(count->big,scratch);
+  if(mpz_sizeinbase(z,2) > 2*LIMB_BITS) return;
+  c2dSize limbs[2] = {0,0};
+  mpz_export(limbs,NULL,-1,sizeof(c2dSize),0,0,z);
+  release_scratch(count,scratch);
+  count->small = limbs[0] | ((c2dWide)limbs[1]<<LIMB_BITS);
+}
+
+/******************************************************************************
+ * operations on counts (see count_kernel.h)
+ ******************************************************************************/
+
+static inline void exact_set(ExactCount* count, c2dWide value) {
+  count->small = value;
+  count->big   = 0;
+}
+
+static inline BOOLEAN exact_is_zero(const ExactCount* count) {
+  return count->big==0 && count->small==0;
+}
+
+//the result is held by the scratch integer of an operand if it has one
+static void exact_mul(ExactCount* count, ExactCount a, ExactCount b, VtreeManager* manager) {
+  c2dWide product;
+  if(a.big==0 && b.big==0 && !__builtin_mul_overflow(a.small,b.small,&product)) {
+    exact_set(count,product);
+    return;
+  }
+  ExactScratch* scratch = exact_scratch(manager);
+  c2dSize big = a.big? a.big: b.big? b.big: claim_scratch(scratch);
+  mpz_mul(scratch_value(big,scratch),exact2mpz(scratch->x,&a,scratch),exact2mpz(scratch->y,&b,scratch));
+  if(b.big && b.big!=big) release_scratch(&b,scratch);
+  count->small = 0;
+  count->big   = big;
+  settle_exact(count,scratch);
+}
+
+static void exact_shannon(ExactCount* count, ExactCount a, Lit* plit, ExactCount b, Lit* nlit, VtreeManager* manager) {
+  c2dSize pweight = literal_weight(plit);
+  c2dSize nweight = literal_weight(nlit);
+  c2dWide x, y, sum;
+  if(a.big==0 && b.big==0 &&
+     !__builtin_mul_overflow(a.small,(c2dWide)pweight,&x) &&
+     !__builtin_mul_overflow(b.small,(c2dWide)nweight,&y) &&
+     !__builtin_add_overflow(x,y,&sum)) {
+    exact_set(count,sum);
+    return;
+  }
+  ExactScratch* scratch = exact_scratch(manager);
+  c2dSize big = a.big? a.big: b.big? b.big: claim_scratch(scratch);
+  mpz_ptr z   = scratch_value(big,scratch);
+  if(big==a.big) {
+    mpz_mul_ui(z,z,pweight);
+    mpz_addmul_ui(z,exact2mpz(scratch->x,&b,scratch),nweight);
+  }
+  else if(big==b.big) {
+    mpz_mul_ui(z,z,nweight);
+    mpz_addmul_ui(z,exact2mpz(scratch->x,&a,scratch),pweight);
+  }
+  else {
+    mpz_mul_ui(z,exact2mpz(scratch->x,&a,scratch),pweight);
+    mpz_addmul_ui(z,exact2mpz(scratch->y,&b,scratch),nweight);
+  }
+  if(b.big && b.big!=big) release_scratch(&b,scratch);
+  count->small = 0;
+  count->big   = big;
+  settle_exact(count,scratch);
+}
+
+//limbs of a count that does not fit in 63 bits are copied to the arena of counts
+static void exact2cache(VtreeCV* item, const ExactCount* count, VtreeManager* manager) {
+  if(count->big==0 && count->small < ((c2dWide)1<<(LIMB_BITS-1))) {
+    item->exact = ((c2dSize)count->small<<1) | 1;
+    return;
+  }
+  c2dSize* cells;
+  if(count->big==0) {
+    cells    = (c2dSize*) new_count_cells(3*sizeof(c2dSize),manager->cache);
+    cells[0] = 2;
+    cells[1] = (c2dSize)count->small;
+    cells[2] = (c2dSize)(count->small>>LIMB_BITS);
+  }
+  else {
+    mpz_srcptr z = scratch_value(count->big,exact_scratch(manager));
+    c2dSize size = (mpz_sizeinbase(z,2)+LIMB_BITS-1)/LIMB_BITS;
+    cells    = (c2dSize*) new_count_cells((size+1)*sizeof(c2dSize),manager->cache);
+    cells[0] = size;
+    mpz_export(cells+1,NULL,-1,sizeof(c2dSize),0,0,z);
+  }
+  item->exact = (c2dSize)cells; //arena cells are word-aligned, so the lowest bit is 0
+}
+
+static void cache2exact(ExactCount* count, VtreeCV item, VtreeManager* manager) {
+  if(item.exact&1) exact_set(count,item.exact>>1);
+  else {
+    const c2dSize* cells = (const c2dSize*)item.exact;
+    if(cells[0]==2) exact_set(count,cells[1] | ((c2dWide)cells[2]<<LIMB_BITS));
+    else {
+      ExactScratch* scratch = exact_scratch(manager);
+      count->small = 0;
+      count->big   = claim_scratch(scratch);
+      mpz_import(scratch_value(count->big,scratch),cells[0],-1,sizeof(c2dSize),0,0,cells+1);
+    }
+  }
+}
+
+//the arena cells of a cached count (see VtreeCountCells)
+static c2dSize exact_cells(VtreeCV* value, BOOLEAN move, VtreeCache* cache) {
+  if(value->exact&1) return 0;
+  const c2dSize* cells = (const c2dSize*)value->exact;
+  c2dSize size         = (cells[0]+1)*sizeof(c2dSize);
+  if(move) {
+    c2dSize* moved = (c2dSize*) new_count_cells(size,cache);
+    memcpy(moved,cells,size);
+    value->exact = (c2dSize)moved;
+  }
+  return size;
+}
+
+/******************************************************************************
+ * counting kernel
+ ******************************************************************************/
+
+#define COUNT_T     ExactCount
+#define COUNT_VTREE exact_count_vtree
+
+#define COUNT_SET_ZERO(c,m)               exact_set(&(c),0)
+#define COUNT_IS_ZERO(c)                  exact_is_zero(&(c))
+#define COUNT_LITERAL(c,lit,m)            exact_set(&(c),literal_weight(lit))
+#define COUNT_FREE_VAR(c,plit,nlit,m)     exact_set(&(c),(c2dWide)literal_weight(plit)+literal_weight(nlit))
+#define COUNT_MUL(c,a,b,m)                exact_mul(&(c),a,b,m)
+#define COUNT_SHANNON(c,a,plit,b,nlit,m)  exact_shannon(&(c),a,plit,b,nlit,m)
+#define COUNT_GET_CACHE(c,item,m)         cache2exact(&(c),item,m)
+#define COUNT_SET_CACHE(item,c,m)         exact2cache(&(item),&(c),m)
+#define COUNT_DISCARD(c,m)                release_scratch(&(c),exact_scratch(m))
+
+static ExactCount exact_count_vtree(VtreeManager* manager, SatState* sat_state);
+
+#include "count_kernel.h"
+
+/******************************************************************************
+ * main exact counting code
+ ******************************************************************************/
+
+//returns 1 if the weights of all literals are nonnegative integers below 2^64
+static BOOLEAN integral_weights(const SatState* sat_state) {
+  for(c2dSize i=1; i<=sat_var_count(sat_state); i++) {
+    Var* var = sat_index2var(i,sat_state);
+    c2dWmc weights[2] = { sat_literal_weight(sat_pos_literal(var)), sat_literal_weight(sat_neg_literal(var)) };
+    for(int j=0; j<2; j++) {
+      c2dWmc w = weights[j];
+      if(!(w>=0 && w<18446744073709551616.0 && w==(c2dWmc)(c2dSize)w)) return 0;
+    }
+  }
+  return 1;
+}
+
+//returns the exact (weighted) model count as a decimal string (to be freed by the caller),
+//or NULL if some literal weight is not a nonnegative integer
+char* count_vtree_exact(VtreeManager* manager, SatState* sat_state) {
+  if(!integral_weights(sat_state)) return NULL;
+
+  ExactScratch* scratch = new_exact_scratch();
+  set_vtree_cache_counts(exact_cells,scratch,manager->cache);
+  ExactCount count = exact_count_vtree(manager,sat_state);
+  char* string = mpz_get_str(NULL,10,exact2mpz(scratch->x,&count,scratch));
+  set_vtree_cache_counts(exact_cells,NULL,manager->cache);
+  free_exact_scratch(scratch);
+  return string;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
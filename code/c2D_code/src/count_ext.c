@@ -0,0 +1,138 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include <math.h>
+#include <float.h>
+#include "c2d.h"
+
+//cache.c
+void* new_count_cells(c2dSize size, VtreeCache* cache);
+void set_vtree_cache_counts(VtreeCountCells count_cells, void* counts, VtreeCache* cache);
+
+/******************************************************************************
+ * (weighted) model counting with extended range: a count is represented by a
+ * mantissa (a double in [0.5,1), or 0) and a 64-bit binary exponent, so it has the
+ * precision of a double but neither underflows nor overflows
+ *
+ * a cached count takes one word: a count that is a normal double is stored as a 
+ * double, and any other count as a pointer (boxed in a NaN) to the arena of exact 
+ * counts (see cache.c)
+ ******************************************************************************/
+
+typedef struct {
+  c2dWmc mantissa; //in [0.5,1), or 0 for a zero count
+  long exponent;   //the count is mantissa*2^exponent
+} ExtCount;
+
+//the state of extended counts (see count_kernel.h) is the weights read with option -w
+//(NULL for the weights of sat_state), which have a single weight function
+static inline c2dWmc literal_weight(Lit* lit, const VtreeManager* manager) {
+  const LiteralWeights* weights = (const LiteralWeights*) manager->cache->counts;
+  if(weights==NULL) return sat_literal_weight(lit);
+  return weights->weights[weights->var_count+sat_literal_index(lit)];
+}
+
+#define MAX_ALIGN 64 //counts this many binary orders smaller than another do not affect their sum
+
+//NaN with a 48-bit payload, which holds the address of a boxed count
+#define BOX_TAG  0x7FF8000000000000UL
+#define BOX_MASK 0xFFFF000000000000UL
+
+static inline void ext_normalize(ExtCount* count, c2dWmc mantissa, long exponent) {
+  int shift;
+  count->mantissa = frexp(mantissa,&shift);
+  count->exponent = count->mantissa==0? 0: exponent+shift;
+}
+
+/******************************************************************************
+ * operations on counts (see count_kernel.h)
+ ******************************************************************************/
+
+static inline void ext_mul(ExtCount* count, ExtCount a, ExtCount b) {
+  ext_normalize(count,a.mantissa*b.mantissa,a.exponent+b.exponent);
+}
+
+static inline ExtCount ext_scale(ExtCount a, c2dWmc weight) {
+  ExtCount count;
+  ext_normalize(&count,a.mantissa*weight,a.exponent);
+  return count;
+}
+
+static inline void ext_add(ExtCount* count, ExtCount a, ExtCount b) {
+  if(a.mantissa==0) { *count = b; return; }
+  if(b.mantissa==0) { *count = a; return; }
+  if(a.exponent < b.exponent) { ExtCount t = a; a = b; b = t; }
+  long shift = a.exponent-b.exponent;
+  if(shift > MAX_ALIGN) { *count = a; return; }
+  ext_normalize(count,a.mantissa+ldexp(b.mantissa,-(int)shift),a.exponent);
+}
+
+static inline void ext2cache(VtreeCV* item, const ExtCount* count, VtreeManager* manager) {
+  if(count->mantissa==0 || (count->exponent > DBL_MIN_EXP && count->exponent <= DBL_MAX_EXP)) {
+    item->count = ldexp(count->mantissa,(int)count->exponent);
+    return;
+  }
+  ExtCount* cell = (ExtCount*) new_count_cells(sizeof(ExtCount),manager->cache);
+  *cell = *count;
+  assert(((c2dSize)cell & BOX_MASK)==0);
+  item->exact = BOX_TAG | (c2dSize)cell;
+}
+
+static inline void cache2ext(ExtCount* count, VtreeCV item) {
+  if((item.exact & BOX_MASK)==BOX_TAG) *count = *(const ExtCount*)(item.exact & ~BOX_MASK);
+  else ext_normalize(count,item.count,0);
+}
+
+//the arena cells of a cached count (see VtreeCountCells)
+static c2dSize ext_cells(VtreeCV* value, BOOLEAN move, VtreeCache* cache) {
+  if((value->exact & BOX_MASK)!=BOX_TAG) return 0;
+  if(move) {
+    ExtCount* cell = (ExtCount*) new_count_cells(sizeof(ExtCount),cache);
+    *cell = *(const ExtCount*)(value->exact & ~BOX_MASK);
+    value->exact = BOX_TAG | (c2dSize)cell;
+  }
+  return sizeof(ExtCount);
+}
+
+/******************************************************************************
+ * counting kernel
+ ******************************************************************************/
+
+#define COUNT_T     ExtCount
+#define COUNT_VTREE ext_count_vtree
+
+#define COUNT_SET_ZERO(c,m)               ext_normalize(&(c),0,0)
+#define COUNT_IS_ZERO(c)                  ((c).mantissa == 0)
+#define COUNT_LITERAL(c,lit,m)            ext_normalize(&(c),literal_weight(lit,m),0)
+#define COUNT_FREE_VAR(c,plit,nlit,m)     ext_normalize(&(c),literal_weight(plit,m)+literal_weight(nlit,m),0)
+#define COUNT_MUL(c,a,b,m)                ext_mul(&(c),a,b)
+#define COUNT_SHANNON(c,a,plit,b,nlit,m)  ext_add(&(c),ext_scale(a,literal_weight(plit,m)),ext_scale(b,literal_weight(nlit,m)))
+#define COUNT_GET_CACHE(c,item,m)         cache2ext(&(c),item)
+#define COUNT_SET_CACHE(item,c,m)         ext2cache(&(item),&(c),m)
+
+static ExtCount ext_count_vtree(VtreeManager* manager, SatState* sat_state);
+
+#include "count_kernel.h"
+
+/******************************************************************************
+ * main counting code
+ ******************************************************************************/
+
+//returns the mantissa of the (weighted) model count, and sets its binary exponent: the
+//count is under weights if not NULL (a single weight function), and under the weights
+//of sat_state otherwise
+c2dWmc count_vtree_ext(long* exponent, const LiteralWeights* weights, VtreeManager* manager, SatState* sat_state) {
+  assert(weights==NULL || weights->count==1);
+  set_vtree_cache_counts(ext_cells,(void*)weights,manager->cache);
+  ExtCount count = ext_count_vtree(manager,sat_state);
+  set_vtree_cache_counts(ext_cells,NULL,manager->cache);
+  *exponent = count.exponent;
+  return count.mantissa;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
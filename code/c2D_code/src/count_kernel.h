@@ -0,0 +1,275 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+/******************************************************************************
+ * (weighted) model counting over a vtree, for a given representation of counts
+ *
+ * this file is included by a counting module (e.g., count.c), which first defines:
+ * --COUNT_T: the type of counts
+ * --COUNT_VTREE: the name of the main counting function
+ * --COUNT_EVIDENCE (optional): the name of the function counting under evidence
+ * --COUNT_EXISTS(v,m) (optional): whether the variables of vtree node v are existential
+ *   (not counted, as in projected counting), with COUNT_SET_ONE(c,m) setting c = 1. a 
+ *   node whose variables are all existential has count 1 if its residual cnf is 
+ *   satisfiable (settled by the first satisfiable branch of a Shannon node) and 0 otherwise
+ * --the following operations on counts of type COUNT_T (lvalues c, a, b):
+ *   COUNT_SET_ZERO(c,m)               c = 0
+ *   COUNT_IS_ZERO(c)                  whether c is 0
+ *   COUNT_LITERAL(c,lit,m)            c = weight of lit
+ *   COUNT_FREE_VAR(c,plit,nlit,m)     c = weight of plit + weight of nlit
+ *   COUNT_MUL(c,a,b,m)                c = a*b (c may be a)
+ *   COUNT_SHANNON(c,a,plit,b,nlit,m)  c = a*(weight of plit) + b*(weight of nlit)
+ *   COUNT_GET_CACHE(c,item,m)         c = count cached in item (a VtreeCV)
+ *   COUNT_SET_CACHE(item,c,m)         item = c (for caching)
+ *   where m is the vtree manager (m->cache->counts holds the state of the representation,
+ *   if any), and the operands a and b of COUNT_MUL and COUNT_SHANNON are not used again
+ * --COUNT_DISCARD(c,m) (optional): releases a count c that is dropped without being used
+ *   (as when a clause is learned after c was counted)
+ *
+ * hence, each representation gets its own copy of the counting code, and the
+ * default (double) representation pays nothing for the others
+ ******************************************************************************/
+
+//cache.c
+BOOLEAN lookup_cache(VtreeCV* item, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
+BOOLEAN vtree_cache_on(const DVtree* vtree, const VtreeManager* manager);
+void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
+void drop_vtree_cache_entries(DVtree* vtree, VtreeManager* manager);
+void set_evidence_epochs(const c2dLiteral* evidence, c2dSize size, VtreeManager* manager);
+BOOLEAN run_under_evidence(const c2dLiteral* evidence, c2dSize size, void (*run)(Clause** learned_clause, void* data), void* data, VtreeManager* manager, SatState* sat_state);
+//cnf_key.c
+void attach_vtree_keys(VtreeManager* manager, SatState* sat_state);
+void detach_vtree_keys(SatState* sat_state);
+
+#ifndef COUNT_DISCARD
+#define COUNT_DISCARD(c,m)
+#endif
+
+//local
+static void count_dispatcher(COUNT_T* count, Clause** learned_clause, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
+
+/******************************************************************************
+ * Three counting cases: leaf nodes, decomposition nodes, and Shannon nodes
+ *
+ * All cases take (COUNT_T* count, Clause** learned_clause) as their first arguments
+ *
+ * After a case returns:
+ * --if *learned_clause==NULL, then *count contains the corresponding model count
+ * --if *learned_clause!=NULL, then a clause was learned and counting was aborted
+ *   (that is, *count is not meaningful)
+ *
+ * When a clause is learned during the counting process, the learned clause must
+ * be asserted (and all learned clauses it leads to must also be asserted) before
+ * counting resumes. For that, we backtrack to the assertion level of the learned
+ * clause
+ ******************************************************************************/
+
+/******************************************************************************
+ * Main (weighted) model counting code
+ ******************************************************************************/
+
+COUNT_T COUNT_VTREE(VtreeManager* manager, SatState* sat_state) {
+
+  COUNT_T count;
+  Clause* learned_clause = NULL;
+  DVtree* vtree          = manager->vtree;
+
+#ifdef COUNT_EVIDENCE
+  set_evidence_epochs(NULL,0,manager); //entries computed under evidence are stale
+#endif
+  attach_vtree_keys(manager,sat_state);
+  if(sat_unit_resolution(sat_state)) { //unit resolution succeeded
+    count_dispatcher(&count,&learned_clause,vtree,manager,sat_state);
+    if(learned_clause!=NULL) COUNT_SET_ZERO(count,manager); //cnf is inconsistent
+  }
+  else COUNT_SET_ZERO(count,manager); //cnf is inconsistent
+
+  sat_undo_unit_resolution(sat_state);
+  detach_vtree_keys(sat_state);
+  return count;
+}
+
+#ifdef COUNT_EVIDENCE
+/******************************************************************************
+ * Counting under evidence (literals that are assumed true)
+ *
+ * Evidence literals are decided before counting at the root. Learned clauses and
+ * cache entries outlive a call, so a stream of evidence queries reuses both: only
+ * entries of vtree nodes on whose variables the evidence changed are invalidated
+ * (see set_evidence_epochs in cache.c)
+ ******************************************************************************/
+
+typedef struct {
+  DVtree* vtree;
+  VtreeManager* manager;
+  SatState* sat_state;
+  COUNT_T count;
+} EvidenceCount;
+
+static void count_under_evidence(Clause** learned_clause, void* data) {
+  EvidenceCount* job = (EvidenceCount*) data;
+  count_dispatcher(&job->count,learned_clause,job->vtree,job->manager,job->sat_state);
+}
+
+//count the models of vtree (a node below the Shannon nodes of all evidence variables, 
+//such as the root) under evidence (see run_under_evidence in cache.c)
+COUNT_T COUNT_EVIDENCE(const c2dLiteral* evidence, c2dSize size, DVtree* vtree, VtreeManager* manager, SatState* sat_state) {
+  EvidenceCount job;
+  job.vtree     = vtree;
+  job.manager   = manager;
+  job.sat_state = sat_state;
+  if(!run_under_evidence(evidence,size,count_under_evidence,&job,manager,sat_state)) COUNT_SET_ZERO(job.count,manager);
+  return job.count;
+}
+#endif
+
+/******************************************************************************
+ * Case I: leaf vtree (count depends on state of associated variable)
+ ******************************************************************************/
+
+static inline void var2count(COUNT_T* count, Var* var, VtreeManager* vtree_manager) {
+  Lit* plit = sat_pos_literal(var);
+  Lit* nlit = sat_neg_literal(var);
+  if(sat_implied_literal(plit))       COUNT_LITERAL(*count,plit,vtree_manager);
+  else if(sat_implied_literal(nlit))  COUNT_LITERAL(*count,nlit,vtree_manager);
+  else COUNT_FREE_VAR(*count,plit,nlit,vtree_manager);
+}
+
+static void count_vtree_leaf(COUNT_T* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager) {
+  assert(vtree_is_leaf(vtree));
+#ifdef COUNT_EXISTS
+  if(COUNT_EXISTS(vtree,vtree_manager)) COUNT_SET_ONE(*count,vtree_manager);
+  else
+#endif
+  var2count(count,vtree->var,vtree_manager);
+  *learned_clause = NULL;
+}
+
+/******************************************************************************
+ * Case II: decomposition node (left and right vtrees are independent)
+ ******************************************************************************/
+
+static void count_vtree_decomposed(COUNT_T* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state) {
+
+  COUNT_T l_count;
+  count_dispatcher(&l_count,learned_clause,vtree->left,vtree_manager,sat_state);
+  if(*learned_clause!=NULL) {
+    drop_vtree_cache_entries(vtree->left,vtree_manager);
+    return;
+  }
+  else if(COUNT_IS_ZERO(l_count)) { //optimization
+    COUNT_SET_ZERO(*count,vtree_manager);
+    return;
+  }
+
+  COUNT_T r_count;
+  count_dispatcher(&r_count,learned_clause,vtree->right,vtree_manager,sat_state);
+  if(*learned_clause!=NULL) {
+    COUNT_DISCARD(l_count,vtree_manager);
+    drop_vtree_cache_entries(vtree,vtree_manager);
+    return;
+  }
+
+  assert(*learned_clause==NULL);
+  COUNT_MUL(*count,l_count,r_count,vtree_manager);
+}
+
+/******************************************************************************
+ * Case III: Shannon node (count based on case analysis)
+ ******************************************************************************/
+
+static void count_vtree_shannon(COUNT_T* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state);
+
+static inline
+BOOLEAN count_with_literal(COUNT_T* count, Clause** learned_clause, Lit* literal, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state) {
+  *learned_clause     = sat_decide_literal(literal,sat_state);
+  if(*learned_clause==NULL) count_dispatcher(count,learned_clause,vtree->right,vtree_manager,sat_state);
+  sat_undo_decide_literal(sat_state);
+  if(*learned_clause!=NULL) { //a clause was learned
+    if(sat_at_assertion_level(*learned_clause,sat_state)) {
+      *learned_clause = sat_assert_clause(*learned_clause,sat_state);
+      //if another clause was learned, its assertion level must be lower (hence, we must backrack)
+      //if another clause was not learned, then we are ready to try vtree again (with the learned clause)
+      if(*learned_clause==NULL) count_vtree_shannon(count,learned_clause,vtree,vtree_manager,sat_state);
+    }
+    return 0; //counting with literal failed as it led to learning at least one clause
+  }
+  else return 1; //counting with literal succeeded without learning clauses
+}
+
+static void count_vtree_shannon(COUNT_T* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state) {
+  Var* var = vtree_shannon_var(vtree);
+
+  if(sat_instantiated_var(var) || sat_irrelevant_var(var)) {
+    count_dispatcher(count,learned_clause,vtree->right,vtree_manager,sat_state);
+#ifdef COUNT_EXISTS
+    if(COUNT_EXISTS(vtree,vtree_manager)) return;
+#endif
+    if(*learned_clause==NULL) {
+      COUNT_T v_count;
+      var2count(&v_count,var,vtree_manager);
+      COUNT_MUL(*count,*count,v_count,vtree_manager);
+    }
+    return;
+  }
+
+  Lit* plit = sat_pos_literal(var);
+  Lit* nlit = sat_neg_literal(var);
+
+  if(!count_with_literal(count,learned_clause,plit,vtree,vtree_manager,sat_state)) return;
+  assert(*learned_clause==NULL);
+  assert(!sat_instantiated_var(var));
+  COUNT_T pcount = *count; //save count conditioned on plit
+#ifdef COUNT_EXISTS
+  if(COUNT_EXISTS(vtree,vtree_manager) && !COUNT_IS_ZERO(pcount)) return; //satisfiable
+#endif
+
+  if(!count_with_literal(count,learned_clause,nlit,vtree,vtree_manager,sat_state)) {
+    COUNT_DISCARD(pcount,vtree_manager);
+    return;
+  }
+  assert(*learned_clause==NULL);
+  assert(!sat_instantiated_var(var));
+  COUNT_T ncount = *count; //save count conditioned on nlit
+#ifdef COUNT_EXISTS
+  if(COUNT_EXISTS(vtree,vtree_manager)) return; //satisfiable iff ncount is 1
+#endif
+
+  COUNT_SHANNON(*count,pcount,plit,ncount,nlit,vtree_manager);
+}
+
+/******************************************************************************
+ * Count dispatcher
+ ******************************************************************************/
+
+static void count_dispatcher(COUNT_T* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state) {
+
+  //check cache
+  VtreeCV item;
+  if(lookup_cache(&item,vtree,vtree_manager,sat_state)) {
+    COUNT_GET_CACHE(*count,item,vtree_manager);
+    *learned_clause = NULL;
+    return;
+  }
+
+  //need to count
+  if(vtree_is_leaf(vtree))
+    count_vtree_leaf(count,learned_clause,vtree,vtree_manager);
+  else if(vtree_is_shannon_node(vtree))
+    count_vtree_shannon(count,learned_clause,vtree,vtree_manager,sat_state);
+  else
+    count_vtree_decomposed(count,learned_clause,vtree,vtree_manager,sat_state);
+
+  //cache if a count is returned (otherwise, a count has not been returned)
+  if(*learned_clause==NULL && vtree_cache_on(vtree,vtree_manager)) {
+    COUNT_SET_CACHE(item,*count,vtree_manager);
+    insert_cache(item,vtree,vtree_manager,sat_state);
+  }
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
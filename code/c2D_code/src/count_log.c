@@ -0,0 +1,75 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include <math.h>
+#include "c2d.h"
+
+//cache.c
+void set_vtree_cache_counts(VtreeCountCells count_cells, void* counts, VtreeCache* cache);
+
+/******************************************************************************
+ * (weighted) model counting in log space: a count is represented by its natural
+ * logarithm (-infinity for 0), so products of small weights do not underflow
+ *
+ * products become sums, and the sums of Shannon nodes are computed by log-sum-exp
+ ******************************************************************************/
+
+//the state of log counts (see count_kernel.h) is the weights read with option -w (NULL
+//for the weights of sat_state), which have a single weight function
+static inline c2dWmc literal_weight(Lit* lit, const VtreeManager* manager) {
+  const LiteralWeights* weights = (const LiteralWeights*) manager->cache->counts;
+  if(weights==NULL) return sat_literal_weight(lit);
+  return weights->weights[weights->var_count+sat_literal_index(lit)];
+}
+
+static inline c2dWmc log_weight(Lit* lit, const VtreeManager* manager) {
+  return log(literal_weight(lit,manager));
+}
+
+//log(exp(a)+exp(b))
+static inline c2dWmc log_sum(c2dWmc a, c2dWmc b) {
+  if(a < b) { c2dWmc t = a; a = b; b = t; }
+  if(b==-INFINITY) return a;
+  return a + log1p(exp(b-a));
+}
+
+/******************************************************************************
+ * counting kernel (see count_kernel.h)
+ ******************************************************************************/
+
+#define COUNT_T     c2dWmc
+#define COUNT_VTREE log_count_vtree
+
+#define COUNT_SET_ZERO(c,m)               ((c) = -INFINITY)
+#define COUNT_IS_ZERO(c)                  ((c) == -INFINITY)
+#define COUNT_LITERAL(c,lit,m)            ((c) = log_weight(lit,m))
+#define COUNT_FREE_VAR(c,plit,nlit,m)     ((c) = log(literal_weight(plit,m) + literal_weight(nlit,m)))
+#define COUNT_MUL(c,a,b,m)                ((c) = (a)+(b))
+#define COUNT_SHANNON(c,a,plit,b,nlit,m)  ((c) = log_sum((a)+log_weight(plit,m),(b)+log_weight(nlit,m)))
+#define COUNT_GET_CACHE(c,item,m)         ((c) = (item).count)
+#define COUNT_SET_CACHE(item,c,m)         ((item).count = (c))
+
+static c2dWmc log_count_vtree(VtreeManager* manager, SatState* sat_state);
+
+#include "count_kernel.h"
+
+/******************************************************************************
+ * main counting code
+ ******************************************************************************/
+
+//returns the natural logarithm of the (weighted) model count, under weights if not
+//NULL (a single weight function) and under the weights of sat_state otherwise
+c2dWmc count_vtree_log(const LiteralWeights* weights, VtreeManager* manager, SatState* sat_state) {
+  assert(weights==NULL || weights->count==1);
+  set_vtree_cache_counts(NULL,(void*)weights,manager->cache);
+  c2dWmc count = log_count_vtree(manager,sat_state);
+  set_vtree_cache_counts(NULL,NULL,manager->cache);
+  return count;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,176 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+/******************************************************************************
+ * (weighted) model counting with the partial derivatives of the count with 
+ * respect to all literal weights
+ *
+ * counting records its trace as an arithmetic circuit: leaves are literal weights,
+ * and internal nodes are the sums and products computed by the counting kernel
+ * (cached counts are shared nodes). each literal has a single leaf, and nodes are
+ * created after their children, so a forward pass over the nodes in order computes
+ * the count and a backward pass in reverse order computes the derivatives
+ *
+ * the marginal of a literal l is then w(l)*(derivative of the count wrt w(l))/count
+ ******************************************************************************/
+
+#define TRACE_ZERO    0
+#define TRACE_LITERAL 1
+#define TRACE_SUM     2
+#define TRACE_PRODUCT 3
+
+typedef struct {
+  BYTE type;
+  c2dSize left;  //children (TRACE_SUM and TRACE_PRODUCT)
+  c2dSize right;
+} TraceNode;
+
+typedef struct {
+  c2dSize var_count;
+  TraceNode* nodes; //nodes[0] is the zero count, nodes[1+var_count+l] is the leaf of literal l
+  c2dSize size;
+  c2dSize capacity;
+} Trace;
+
+//the trace of the current count
+static Trace* trace;
+
+static inline c2dSize literal_node(Lit* lit) {
+  return 1+trace->var_count+sat_literal_index(lit);
+}
+
+static c2dSize new_trace_node(BYTE type, c2dSize left, c2dSize right) {
+  if(trace->size==trace->capacity) {
+    trace->capacity *= 2;
+    trace->nodes = (TraceNode*) realloc(trace->nodes,trace->capacity*sizeof(TraceNode));
+  }
+  TraceNode* node = trace->nodes+trace->size;
+  node->type  = type;
+  node->left  = left;
+  node->right = right;
+  return trace->size++;
+}
+
+static inline c2dSize trace_sum(c2dSize a, c2dSize b) {
+  if(a==0) return b;
+  if(b==0) return a;
+  return new_trace_node(TRACE_SUM,a,b);
+}
+
+static inline c2dSize trace_product(c2dSize a, c2dSize b) {
+  if(a==0 || b==0) return 0;
+  return new_trace_node(TRACE_PRODUCT,a,b);
+}
+
+/******************************************************************************
+ * counting kernel (see count_kernel.h): counts are trace nodes
+ ******************************************************************************/
+
+#define COUNT_T     c2dSize
+#define COUNT_VTREE trace_count_vtree
+
+#define COUNT_SET_ZERO(c,m)               ((c) = 0)
+#define COUNT_IS_ZERO(c)                  ((c) == 0)
+#define COUNT_LITERAL(c,lit,m)            ((c) = literal_node(lit))
+#define COUNT_FREE_VAR(c,plit,nlit,m)     ((c) = trace_sum(literal_node(plit),literal_node(nlit)))
+#define COUNT_MUL(c,a,b,m)                ((c) = trace_product(a,b))
+#define COUNT_SHANNON(c,a,plit,b,nlit,m)  ((c) = trace_sum(trace_product(a,literal_node(plit)),trace_product(b,literal_node(nlit))))
+#define COUNT_GET_CACHE(c,item,m)         ((c) = (item).exact)
+#define COUNT_SET_CACHE(item,c,m)         ((item).exact = (c))
+
+static c2dSize trace_count_vtree(VtreeManager* manager, SatState* sat_state);
+
+#include "count_kernel.h"
+
+/******************************************************************************
+ * main counting code
+ ******************************************************************************/
+
+//returns the weight of literal l: from weights (the first weight function) if not NULL, 
+//and from sat_state otherwise
+static c2dWmc literal_weight(c2dLiteral l, const LiteralWeights* weights, SatState* sat_state) {
+  if(weights!=NULL) return weights->weights[(weights->var_count+l)*weights->count];
+  return sat_literal_weight(sat_index2literal(l,sat_state));
+}
+
+//returns the (weighted) model count, and sets derivatives[l] to its partial derivative 
+//with respect to the weight of literal l (for 0<|l|<=var_count)
+c2dWmc count_vtree_marginals(c2dWmc* derivatives, const LiteralWeights* weights, VtreeManager* manager, SatState* sat_state) {
+  c2dSize var_count = sat_var_count(sat_state);
+
+  Trace t;
+  t.var_count = var_count;
+  t.capacity  = 2*(var_count+1)+1024;
+  t.nodes     = (TraceNode*) malloc(t.capacity*sizeof(TraceNode));
+  t.size      = 0;
+  trace       = &t;
+  new_trace_node(TRACE_ZERO,0,0);
+  for(c2dSize i=0; i<2*var_count+1; i++) new_trace_node(i==var_count? TRACE_ZERO: TRACE_LITERAL,0,0);
+
+  c2dSize root = trace_count_vtree(manager,sat_state);
+
+  //forward pass
+  c2dWmc* values = (c2dWmc*) malloc(2*t.size*sizeof(c2dWmc));
+  c2dWmc* diffs  = values+t.size;
+  for(c2dSize i=0; i<t.size; i++) {
+    TraceNode* node = t.nodes+i;
+    switch(node->type) {
+      case TRACE_ZERO:    values[i] = 0; break;
+      case TRACE_LITERAL: values[i] = literal_weight((c2dLiteral)i-1-(c2dLiteral)var_count,weights,sat_state); break;
+      case TRACE_SUM:     values[i] = values[node->left]+values[node->right]; break;
+      case TRACE_PRODUCT: values[i] = values[node->left]*values[node->right]; break;
+    }
+    diffs[i] = 0;
+  }
+
+  //backward pass
+  diffs[root] = 1;
+  for(c2dSize i=root; i>0; i--) {
+    TraceNode* node = t.nodes+i;
+    if(diffs[i]==0) continue;
+    if(node->type==TRACE_SUM) {
+      diffs[node->left]  += diffs[i];
+      diffs[node->right] += diffs[i];
+    }
+    else if(node->type==TRACE_PRODUCT) {
+      diffs[node->left]  += diffs[i]*values[node->right];
+      diffs[node->right] += diffs[i]*values[node->left];
+    }
+  }
+
+  for(c2dLiteral l=-(c2dLiteral)var_count; l<=(c2dLiteral)var_count; l++) derivatives[l] = diffs[1+var_count+l];
+  c2dWmc count = values[root];
+
+  free(values);
+  free(t.nodes);
+  trace = NULL;
+  return count;
+}
+
+//saves the derivative and marginal of each literal to a file, one literal per line
+void save_marginals(const char* fname, c2dWmc count, const c2dWmc* derivatives, const LiteralWeights* weights, SatState* sat_state) {
+  FILE* file = fopen(fname,"w");
+  if(file==NULL) {
+    fprintf(stderr,"\nc2D: cannot write marginals to %s\n",fname);
+    exit(1);
+  }
+  fprintf(file,"c literal derivative marginal\n");
+  fprintf(file,"c count %.17g\n",count);
+  c2dLiteral var_count = sat_var_count(sat_state);
+  for(c2dLiteral v=1; v<=var_count; v++) {
+    for(c2dLiteral l=v; l>=-v; l-=2*v) {
+      c2dWmc marginal = count==0? 0: literal_weight(l,weights,sat_state)*derivatives[l]/count;
+      fprintf(file,"%ld %.17g %.17g\n",l,derivatives[l],marginal);
+    }
+  }
+  fclose(file);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
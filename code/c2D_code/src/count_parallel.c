@@ -0,0 +1,81 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+//count.c
+c2dWmc count_vtree_evidence(const c2dLiteral* evidence, c2dSize size, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
+//component.c
+void share_component_cache(c2dSize jobs, ComponentCache* components);
+//parallel.c
+VtreeTask* split_vtree_tasks(DVtree* root, c2dSize jobs, c2dSize* count);
+void free_vtree_tasks(VtreeTask* tasks, c2dSize count);
+void* new_shared_memory(c2dSize bytes);
+void free_shared_memory(void* memory, c2dSize bytes);
+void run_vtree_tasks(const VtreeTask* tasks, c2dSize count, c2dSize jobs, void (*run_task)(c2dSize index, c2dSize job, void* data), void* data);
+
+/******************************************************************************
+ * parallel (weighted) model counting over a vtree (see parallel.c)
+ *
+ * a task is counted under its cube as evidence (see COUNT_EVIDENCE in count_kernel.h),
+ * which also handles cubes that contradict the cnf (count 0). counts of split tasks
+ * are products (decomposition nodes) or weighted sums (Shannon nodes) of the counts
+ * of their subtasks. counts of residual cnfs (option -S) are shared by all jobs through
+ * one component table in shared memory (see component.c)
+ ******************************************************************************/
+
+typedef struct {
+  const VtreeTask* tasks;
+  c2dWmc* counts;     //in shared memory
+  VtreeManager* manager;
+  SatState* sat_state;
+} CountJob;
+
+static void count_task(c2dSize index, c2dSize job_index, void* data) {
+  CountJob* job = (CountJob*) data;
+  const VtreeTask* task = job->tasks+index;
+  ComponentCache* components = job->manager->cache->components;
+  if(components!=NULL) components->job = job_index;
+  job->counts[index] = count_vtree_evidence(task->cube,task->size,task->vtree,job->manager,job->sat_state);
+}
+
+//combine the counts of subtasks into the counts of split tasks (subtasks come after their task)
+static c2dWmc combine_tasks(const VtreeTask* tasks, c2dSize count, c2dWmc* counts) {
+  for(c2dSize i=count; i>0; i--) {
+    const VtreeTask* task = tasks+i-1;
+    if(task->left==0) continue;
+    c2dWmc l_count = counts[task->left];
+    c2dWmc r_count = counts[task->right];
+    if(vtree_is_shannon_node(task->vtree)) {
+      Var* var = vtree_shannon_var(task->vtree);
+      counts[i-1] = l_count*sat_literal_weight(sat_pos_literal(var)) + r_count*sat_literal_weight(sat_neg_literal(var));
+    }
+    else counts[i-1] = l_count*r_count;
+  }
+  return counts[0];
+}
+
+//returns the (weighted) model count, counted by jobs processes
+c2dWmc count_vtree_parallel(c2dSize jobs, VtreeManager* manager, SatState* sat_state) {
+  c2dSize count;
+  VtreeTask* tasks = split_vtree_tasks(manager->vtree,jobs,&count);
+  c2dWmc* counts   = (c2dWmc*) new_shared_memory(count*sizeof(c2dWmc));
+  //with option -S, jobs share one component table
+  ComponentCache* components = manager->cache->components;
+  if(components!=NULL && components->shared==NULL) share_component_cache(jobs,components);
+
+  CountJob job = { tasks, counts, manager, sat_state };
+  run_vtree_tasks(tasks,count,jobs,count_task,&job);
+  c2dWmc wmc = combine_tasks(tasks,count,counts);
+
+  free_shared_memory(counts,count*sizeof(c2dWmc));
+  free_vtree_tasks(tasks,count);
+  return wmc;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
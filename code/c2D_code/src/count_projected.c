@@ -0,0 +1,199 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _DEFAULT_SOURCE //mkstemp and fdopen
+#include "c2d.h"
+
+/******************************************************************************
+ * projected (weighted) model counting: the models of the cnf are counted over a
+ * subset of its variables (the projection variables), while the other variables 
+ * are existential
+ *
+ * the vtree puts projection variables above existential ones wherever they are decided
+ * together (see save_projected_node), so each existential sub-problem is the residual
+ * cnf of a vtree node whose variables are all existential. such a node is settled by a
+ * satisfiability search with the sat state of the count (see COUNT_EXISTS in 
+ * count_kernel.h), whose result is cached like a count
+ *
+ * projection variables are read from lines "c p show v_1 ... v_k 0" (or "c ind ...")
+ * of a file, which can be the cnf itself
+ ******************************************************************************/
+
+//existential[p] is 1 if the variables of the vtree node at position p are all existential
+static BOOLEAN* existential;
+
+static inline BOOLEAN existential_vtree(const DVtree* vtree) {
+  return existential[vtree->position];
+}
+
+/******************************************************************************
+ * counting kernel (see count_kernel.h)
+ ******************************************************************************/
+
+#define COUNT_T     c2dWmc
+#define COUNT_VTREE projected_count_vtree
+
+#define COUNT_SET_ZERO(c,m)               ((c) = 0)
+#define COUNT_SET_ONE(c,m)                ((c) = 1)
+#define COUNT_IS_ZERO(c)                  ((c) == 0)
+#define COUNT_LITERAL(c,lit,m)            ((c) = sat_literal_weight(lit))
+#define COUNT_FREE_VAR(c,plit,nlit,m)     ((c) = (sat_literal_weight(plit) + sat_literal_weight(nlit)))
+#define COUNT_MUL(c,a,b,m)                ((c) = (a)*(b))
+#define COUNT_SHANNON(c,a,plit,b,nlit,m)  ((c) = ((a)*sat_literal_weight(plit)) + ((b)*sat_literal_weight(nlit)))
+#define COUNT_GET_CACHE(c,item,m)         ((c) = (item).count)
+#define COUNT_SET_CACHE(item,c,m)         ((item).count = (c))
+#define COUNT_EXISTS(v,m)                 existential_vtree(v)
+
+static c2dWmc projected_count_vtree(VtreeManager* manager, SatState* sat_state);
+
+#include "count_kernel.h"
+
+/******************************************************************************
+ * projection variables and the projected vtree
+ ******************************************************************************/
+
+//returns projected[i] = 1 iff variable i is a projection variable (to be freed by the caller),
+//or NULL if fname cannot be read or has no projection variables
+BOOLEAN* read_projection(const char* fname, const SatState* sat_state) {
+  FILE* file = fopen(fname,"r");
+  if(file==NULL) return NULL;
+
+  c2dSize var_count = sat_var_count(sat_state);
+  BOOLEAN* projected = (BOOLEAN*) calloc(var_count+1,sizeof(BOOLEAN));
+  c2dSize count = 0;
+  char line[16];
+  while(fscanf(file," %15s",line)==1) {
+    if(strcmp(line,"c")) continue;
+    if(fscanf(file," %15s",line)!=1) break;
+    BOOLEAN show = 0;
+    if(!strcmp(line,"ind")) show = 1;
+    else if(!strcmp(line,"p")) show = fscanf(file," %15s",line)==1 && !strcmp(line,"show");
+    if(!show) continue;
+    long var;
+    while(fscanf(file," %ld",&var)==1 && var!=0) {
+      if(var<0 || var>(long)var_count) continue;
+      if(!projected[var]) ++count;
+      projected[var] = 1;
+    }
+  }
+  fclose(file);
+
+  if(count==0) {
+    free(projected);
+    return NULL;
+  }
+  return projected;
+}
+
+//returns 1 if all variables of vtree are existential
+static BOOLEAN existential_vars(const DVtree* vtree, const BOOLEAN* projected) {
+  if(vtree_is_leaf(vtree)) return !projected[sat_var_index(vtree->var)];
+  return existential_vars(vtree->left,projected) && existential_vars(vtree->right,projected);
+}
+
+//append the variables of vtree to vars (from left to right)
+static void vtree_vars(const DVtree* vtree, c2dSize* vars, c2dSize* size) {
+  if(vtree_is_leaf(vtree)) vars[(*size)++] = sat_var_index(vtree->var);
+  else {
+    vtree_vars(vtree->left,vars,size);
+    vtree_vars(vtree->right,vars,size);
+  }
+}
+
+//writes the nodes of a right-linear vtree over the variables of vtree (projection variables
+//first) to file, children before parents, and returns the id of its root
+static c2dSize save_linear_vtree(FILE* file, const DVtree* vtree, const BOOLEAN* projected, c2dSize* next_id) {
+  c2dSize* vars  = (c2dSize*) malloc(2*vtree->var_count*sizeof(c2dSize));
+  c2dSize* order = vars+vtree->var_count;
+  c2dSize size   = 0;
+  vtree_vars(vtree,vars,&size);
+  size = 0;
+  for(c2dSize i=0; i<vtree->var_count; i++) if(projected[vars[i]])  order[size++] = vars[i];
+  for(c2dSize i=0; i<vtree->var_count; i++) if(!projected[vars[i]]) order[size++] = vars[i];
+
+  c2dSize first = *next_id; //the leaf of order[i] has id first+i
+  for(c2dSize i=0; i<size; i++) fprintf(file,"L %"PRIvS" %"PRIvS"\n",(*next_id)++,order[i]);
+  c2dSize root = first+size-1;
+  for(c2dSize i=size-1; i>0; i--) {
+    fprintf(file,"I %"PRIvS" %"PRIvS" %"PRIvS"\n",*next_id,first+i-1,root);
+    root = (*next_id)++;
+  }
+  free(vars);
+  return root;
+}
+
+//writes the nodes of the projected vtree of vtree to file, children before parents, and 
+//returns the id of its root
+//
+//an existential variable must not be decided while projection variables remain in the 
+//residual cnf: a Shannon node with an existential variable and projection variables is
+//replaced by a right-linear vtree over its variables, with projection variables first
+static c2dSize save_projected_node(FILE* file, const DVtree* vtree, const BOOLEAN* projected, c2dSize* next_id) {
+  if(vtree_is_leaf(vtree)) {
+    fprintf(file,"L %"PRIvS" %"PRIvS"\n",*next_id,sat_var_index(vtree->var));
+    return (*next_id)++;
+  }
+  if(vtree_is_shannon_node(vtree) && !projected[sat_var_index(vtree_shannon_var(vtree))] && 
+     !existential_vars(vtree->right,projected))
+    return save_linear_vtree(file,vtree,projected,next_id);
+  c2dSize left  = save_projected_node(file,vtree->left,projected,next_id);
+  c2dSize right = save_projected_node(file,vtree->right,projected,next_id);
+  fprintf(file,"I %"PRIvS" %"PRIvS" %"PRIvS"\n",*next_id,left,right);
+  return (*next_id)++;
+}
+
+//saves the projected vtree of vtree (see save_projected_node) to a new temporary file 
+//(in TMPDIR, or /tmp), and returns its name. the caller removes the file once the vtree 
+//is loaded
+char* save_projected_vtree(const DVtree* vtree, const BOOLEAN* projected) {
+  const char* dir = getenv("TMPDIR");
+  if(dir==NULL || *dir=='\0') dir = "/tmp";
+  char* fname = (char*) malloc(strlen(dir)+32);
+  sprintf(fname,"%s/c2d_projected_XXXXXX",dir);
+  int fd = mkstemp(fname);
+  FILE* file = fd<0? NULL: fdopen(fd,"w");
+  if(file==NULL) {
+    fprintf(stderr,"\nc2D: cannot write projected vtree to %s\n",fname);
+    exit(1);
+  }
+  c2dSize next_id = 0;
+  fprintf(file,"vtree %"PRIvS"\n",2*vtree->var_count-1);
+  save_projected_node(file,vtree,projected,&next_id);
+  fclose(file);
+  return fname;
+}
+
+/******************************************************************************
+ * main counting code
+ ******************************************************************************/
+
+static BOOLEAN mark_existential(const DVtree* vtree, const BOOLEAN* projected) {
+  BOOLEAN exists;
+  if(vtree_is_leaf(vtree)) exists = !projected[sat_var_index(vtree->var)];
+  else {
+    BOOLEAN left  = mark_existential(vtree->left,projected);
+    BOOLEAN right = mark_existential(vtree->right,projected);
+    exists = left && right;
+  }
+  existential[vtree->position] = exists;
+  return exists;
+}
+
+//returns the (weighted) model count projected on the variables marked in projected
+c2dWmc count_vtree_projected(const BOOLEAN* projected, VtreeManager* manager, SatState* sat_state) {
+  existential = (BOOLEAN*) malloc((2*sat_var_count(sat_state)-1)*sizeof(BOOLEAN));
+  mark_existential(manager->vtree,projected);
+
+  c2dWmc count = projected_count_vtree(manager,sat_state);
+
+  free(existential);
+  existential = NULL;
+  return count;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
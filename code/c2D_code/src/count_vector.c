@@ -0,0 +1,125 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _DEFAULT_SOURCE //posix_memalign
+#include "c2d.h"
+
+//cache.c
+void* new_count_cells(c2dSize size, VtreeCache* cache);
+void free_count_cells(VtreeCache* cache);
+void set_vtree_cache_counts(VtreeCountCells count_cells, void* counts, VtreeCache* cache);
+
+/******************************************************************************
+ * (weighted) model counting under many weight functions in one traversal
+ *
+ * a count is a vector of VECTOR_WIDTH doubles (one lane per weight function), so
+ * the search, its learned clauses and its cache lookups are shared by all lanes
+ * of the vector. K weight functions take ceil(K/VECTOR_WIDTH) traversals, and the
+ * cache is invalidated between traversals (learned clauses are kept)
+ *
+ * a cached count vector is stored in the arena of exact counts (see cache.c), and
+ * the cache entry holds a pointer to it
+ ******************************************************************************/
+
+#define VECTOR_WIDTH 8
+
+typedef c2dWmc c2dWmcVector __attribute__((vector_size(VECTOR_WIDTH*sizeof(c2dWmc))));
+
+//wrapped so that counts are passed and returned like structures (not vector registers)
+typedef struct {
+  c2dWmcVector lanes;
+} VectorCount;
+
+//the state of vector counts (see count_kernel.h) is the weight vectors of the current
+//traversal: ((const c2dWmcVector*)counts)[l] is that of the literal with index l
+static inline const c2dWmcVector* literal_weights(Lit* lit, const VtreeManager* manager) {
+  return (const c2dWmcVector*)manager->cache->counts+sat_literal_index(lit);
+}
+
+static inline BOOLEAN vector_is_zero(const VectorCount* count) {
+  for(int j=0; j<VECTOR_WIDTH; j++) if(count->lanes[j]!=0) return 0;
+  return 1;
+}
+
+static inline void vector2cache(VtreeCV* item, const VectorCount* count, VtreeManager* manager) {
+  void* cells = new_count_cells(sizeof(VectorCount),manager->cache);
+  memcpy(cells,count,sizeof(VectorCount)); //arena cells are only word-aligned
+  item->exact = (c2dSize)cells;
+}
+
+static inline void cache2vector(VectorCount* count, VtreeCV item) {
+  memcpy(count,(const void*)item.exact,sizeof(VectorCount));
+}
+
+//the arena cells of a cached count (see VtreeCountCells)
+static c2dSize vector_cells(VtreeCV* value, BOOLEAN move, VtreeCache* cache) {
+  if(move) {
+    void* cells = new_count_cells(sizeof(VectorCount),cache);
+    memcpy(cells,(const void*)value->exact,sizeof(VectorCount));
+    value->exact = (c2dSize)cells;
+  }
+  return sizeof(VectorCount);
+}
+
+/******************************************************************************
+ * counting kernel (see count_kernel.h)
+ ******************************************************************************/
+
+#define COUNT_T     VectorCount
+#define COUNT_VTREE vector_count_vtree
+
+#define COUNT_SET_ZERO(c,m)               ((c).lanes = (c2dWmcVector){0})
+#define COUNT_IS_ZERO(c)                  vector_is_zero(&(c))
+#define COUNT_LITERAL(c,lit,m)            ((c).lanes = *literal_weights(lit,m))
+#define COUNT_FREE_VAR(c,plit,nlit,m)     ((c).lanes = *literal_weights(plit,m)+*literal_weights(nlit,m))
+#define COUNT_MUL(c,a,b,m)                ((c).lanes = (a).lanes*(b).lanes)
+#define COUNT_SHANNON(c,a,plit,b,nlit,m)  ((c).lanes = (a).lanes*(*literal_weights(plit,m))+(b).lanes*(*literal_weights(nlit,m)))
+#define COUNT_GET_CACHE(c,item,m)         cache2vector(&(c),item)
+#define COUNT_SET_CACHE(item,c,m)         vector2cache(&(item),&(c),m)
+
+static VectorCount vector_count_vtree(VtreeManager* manager, SatState* sat_state);
+
+#include "count_kernel.h"
+
+/******************************************************************************
+ * main counting code
+ ******************************************************************************/
+
+//returns the (weighted) model count under each weight function (to be freed by the caller)
+c2dWmc* count_vtree_vector(const LiteralWeights* weights, VtreeManager* manager, SatState* sat_state) {
+  c2dSize var_count = weights->var_count;
+  c2dWmc* counts    = (c2dWmc*) malloc(weights->count*sizeof(c2dWmc));
+  c2dWmcVector* lanes;
+  //vector loads of weights assume their alignment
+  if(posix_memalign((void**)&lanes,sizeof(c2dWmcVector),(2*var_count+1)*sizeof(c2dWmcVector))) {
+    fprintf(stderr,"\nc2D: cannot allocate memory for weight vectors\n");
+    exit(1);
+  }
+  set_vtree_cache_counts(vector_cells,lanes+var_count,manager->cache);
+
+  for(c2dSize first=0; first<weights->count; first+=VECTOR_WIDTH) {
+    //lanes past the last weight function have weights 1
+    for(c2dSize i=0; i<2*var_count+1; i++) {
+      const c2dWmc* row = weights->weights+i*weights->count;
+      for(c2dSize j=0; j<VECTOR_WIDTH; j++) lanes[i][j] = first+j<weights->count? row[first+j]: 1;
+    }
+
+    VectorCount count = vector_count_vtree(manager,sat_state);
+    for(c2dSize j=0; j<VECTOR_WIDTH && first+j<weights->count; j++) counts[first+j] = count.lanes[j];
+
+    //cached counts are for the weight functions of this traversal
+    drop_vtree_cache_entries(manager->vtree,manager);
+    free_count_cells(manager->cache);
+  }
+
+  set_vtree_cache_counts(vector_cells,NULL,manager->cache);
+  free(lanes);
+  return counts;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
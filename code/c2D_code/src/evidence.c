@@ -0,0 +1,74 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+//count.c
+c2dWmc count_vtree_evidence(const c2dLiteral* evidence, c2dSize size, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
+
+/******************************************************************************
+ * answering a stream of evidence queries with one vtree, cache and sat state
+ *
+ * a queries file has one query per line: the literals of its evidence (as in dimacs)
+ * terminated by 0. lines starting with c are comments. the file "-" is stdin, so 
+ * queries can be answered as they arrive
+ ******************************************************************************/
+
+//reads the next query into evidence (growing it as needed), and sets its size
+//returns 0 when there are no more queries
+BOOLEAN read_query(FILE* file, c2dLiteral** evidence, c2dSize* size, c2dSize* capacity, c2dSize var_count) {
+  int c;
+  while((c=fgetc(file))==' ' || c=='\t' || c=='\n' || c=='\r' || c=='c') {
+    if(c=='c') while((c=fgetc(file))!=EOF && c!='\n');
+  }
+  if(c==EOF) return 0;
+  ungetc(c,file);
+
+  *size = 0;
+  long literal;
+  while(1) {
+    if(fscanf(file,"%ld",&literal)!=1 || labs(literal)>(long)var_count) {
+      fprintf(stderr,"\nc2D: malformed evidence query\n");
+      exit(1);
+    }
+    if(literal==0) return 1;
+    if(*size==*capacity) {
+      *capacity = *capacity? 2*(*capacity): 64;
+      *evidence = (c2dLiteral*) realloc(*evidence,*capacity*sizeof(c2dLiteral));
+    }
+    (*evidence)[(*size)++] = literal;
+  }
+}
+
+//prints the (weighted) model count under the evidence of each query in fname
+void count_queries(const char* fname, VtreeManager* manager, SatState* sat_state) {
+  FILE* file = strcmp(fname,"-")? fopen(fname,"r"): stdin;
+  if(file==NULL) {
+    fprintf(stderr,"\nc2D: cannot read evidence queries from %s\n",fname);
+    exit(1);
+  }
+
+  c2dLiteral* evidence = NULL;
+  c2dSize size         = 0;
+  c2dSize capacity     = 0;
+  c2dSize queries      = 0;
+  printf("\nQueries:");
+  while(read_query(file,&evidence,&size,&capacity,sat_var_count(sat_state))) {
+    clock_t start_t = clock();
+    c2dWmc count = count_vtree_evidence(evidence,size,manager->vtree,manager,sat_state);
+    clock_t query_t = clock()-start_t;
+    printf("\n  Query %"PRIvS" \t%0.3"PRIwmcS" \t%0.3fs",++queries,count,((double)(query_t))/CLOCKS_PER_SEC);
+    fflush(stdout);
+  }
+  printf("\n  Learned clauses      \t%"PRIvS"",sat_learned_clause_count(sat_state));
+
+  free(evidence);
+  if(file!=stdin) fclose(file);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
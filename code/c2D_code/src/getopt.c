@@ -19,12 +19,24 @@ const char* c2d_version();
 #define VTREE_COUNT    25;
 #define INITIAL_UBFS   25;
 #define FINAL_UBFS     25;
-#define CACHE_CAPACITY 20000003;
+#define CACHE_CAPACITY 65536;
+#define CACHE_MEMORY   0;
+#define MIN_HIT_RATE   0;
+#define VERIFY_KEYS    0;
+#define COUNT_TYPE     'd';
+#define JOBS           1;
+#define CHECKPOINT     0;
+#define LEARNED_SIZE   0;
+#define LEARNED_LBD    0;
 
 #define IN_MEMORY    0;
 #define CHECK_ENTAIL 0;
 #define COUNT_MODELS 0;
 #define COUNTER      0;
+#define HASH_KEYS    0;
+#define SHARE_CACHE  0;
+#define DYNAMIC      0;
+#define EXACT        0;
 
 /******************************************************************************
  * c2d options 
@@ -43,6 +55,29 @@ c2dOptions* init_options() {
   options->initial_ubfs       = INITIAL_UBFS;
   options->final_ubfs         = FINAL_UBFS;
   options->cache_capacity     = CACHE_CAPACITY;
+  options->cache_memory       = CACHE_MEMORY;
+  options->min_hit_rate       = MIN_HIT_RATE;
+  options->hash_keys          = HASH_KEYS;
+  options->verify_keys        = VERIFY_KEYS;
+  options->share_cache        = SHARE_CACHE;
+  options->dynamic            = DYNAMIC;
+  options->exact              = EXACT;
+  options->count_type         = COUNT_TYPE;
+  options->weights_filename   = NULL;
+  options->marginals_filename = NULL;
+  options->queries_filename   = NULL;
+  options->projection_filename = NULL;
+  options->jobs               = JOBS;
+  options->shared_segment     = NULL;
+  options->cache_filename     = NULL;
+  options->checkpoint         = CHECKPOINT;
+  options->learned_filename   = NULL;
+  options->learned_size       = LEARNED_SIZE;
+  options->learned_lbd        = LEARNED_LBD;
+  options->nnf_queries_filename = NULL;
+  options->nnf_in_filename    = NULL;
+  options->nnf_binary_filename = NULL;
+  options->nnf_text_filename  = NULL;
   options->in_memory          = IN_MEMORY;
   options->check_entail       = CHECK_ENTAIL;
   options->count_models       = COUNT_MODELS;
@@ -66,6 +101,29 @@ c2dOptions* get_options(int argc, char** argv) {
       {"initial_ubfs",   required_argument, 0, 'u'},
       {"final_ubfs",     required_argument, 0, 'f'},
       {"cache_capacity", required_argument, 0, 's'},
+      {"cache_mem",      required_argument, 0, 'M'},
+      {"min_hit_rate",   required_argument, 0, 'R'},
+      {"hash_keys",      no_argument,       0, 'H'},
+      {"verify_keys",    required_argument, 0, 'V'},
+      {"share_cache",    no_argument,       0, 'S'},
+      {"dynamic",        no_argument,       0, 'D'},
+      {"exact",          no_argument,       0, 'x'},
+      {"count_type",     required_argument, 0, 'N'},
+      {"weights",        required_argument, 0, 'w'},
+      {"marginals",      required_argument, 0, 'g'},
+      {"queries",        required_argument, 0, 'q'},
+      {"projection",     required_argument, 0, 'P'},
+      {"jobs",           required_argument, 0, 'j'},
+      {"shared_segment", required_argument, 0, 'Z'},
+      {"cache_file",     required_argument, 0, 'K'},
+      {"checkpoint",     required_argument, 0, 'T'},
+      {"learned_file",   required_argument, 0, 'L'},
+      {"learned_size",   required_argument, 0, 'l'},
+      {"learned_lbd",    required_argument, 0, 'B'},
+      {"nnf_queries",    required_argument, 0, 'e'},
+      {"nnf_in",         required_argument, 0, 'n'},
+      {"nnf_binary_out", required_argument, 0, 'O'},
+      {"nnf_text_out",   required_argument, 0, 'F'},
       {"in_memory",      no_argument,       0, 'i'},
       {"check_entail",   no_argument,       0, 'E'},
       {"count_models",   no_argument,       0, 'C'},
@@ -75,7 +133,7 @@ c2dOptions* get_options(int argc, char** argv) {
     };
 
     int index = 0;
-    int argument = getopt_long(argc,argv,"c:v:o:d:t:m:b:u:f:s:iECWh",long_options,&index);
+    int argument = getopt_long(argc,argv,"c:v:o:d:t:m:b:u:f:s:M:R:HV:SDxN:w:g:q:P:j:Z:K:T:L:l:B:e:n:O:F:iECWh",long_options,&index);
     if(argument==-1) break;
 
     switch(argument) {
@@ -89,6 +147,29 @@ c2dOptions* get_options(int argc, char** argv) {
       case 'u': options->initial_ubfs       = atoi(optarg);  break;
       case 'f': options->final_ubfs         = atoi(optarg);  break;
       case 's': options->cache_capacity     = atoi(optarg);  break;
+      case 'M': options->cache_memory       = atoi(optarg);  break;
+      case 'R': options->min_hit_rate       = atof(optarg);  break;
+      case 'H': options->hash_keys          = 1;             break;
+      case 'V': options->verify_keys        = atoi(optarg);  break;
+      case 'S': options->share_cache        = 1;             break;
+      case 'D': options->dynamic            = 1;             break;
+      case 'x': options->exact              = 1;             break;
+      case 'N': options->count_type         = optarg[0];     break;
+      case 'w': options->weights_filename   = optarg;        break;
+      case 'g': options->marginals_filename = optarg;        break;
+      case 'q': options->queries_filename   = optarg;        break;
+      case 'P': options->projection_filename = optarg;       break;
+      case 'j': options->jobs               = atoi(optarg);  break;
+      case 'Z': options->shared_segment     = optarg;        break;
+      case 'K': options->cache_filename     = optarg;        break;
+      case 'T': options->checkpoint         = atoi(optarg);  break;
+      case 'L': options->learned_filename   = optarg;        break;
+      case 'l': options->learned_size       = atoi(optarg);  break;
+      case 'B': options->learned_lbd        = atoi(optarg);  break;
+      case 'e': options->nnf_queries_filename = optarg;      break;
+      case 'n': options->nnf_in_filename    = optarg;        break;
+      case 'O': options->nnf_binary_filename = optarg;       break;
+      case 'F': options->nnf_text_filename  = optarg;        break;
       case 'i': options->in_memory          = 1;             break;
       case 'E': options->check_entail       = 1;             break;
       case 'C': options->count_models       = 1;             break;
@@ -134,6 +215,147 @@ c2dOptions* get_options(int argc, char** argv) {
     fprintf(stderr,"%s: option -s must be greater than 0\n",C2D_PACKAGE);
     print_help(C2D_PACKAGE,1);
   }
+  if(options->cache_memory < 0) {
+    fprintf(stderr,"%s: option -M must not be negative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->min_hit_rate < 0 || options->min_hit_rate > 100) {
+    fprintf(stderr,"%s: option -R must be between 0 and 100 (inclusive)\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->verify_keys < 0) {
+    fprintf(stderr,"%s: option -V must not be negative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->verify_keys > 0 && !options->hash_keys) {
+    fprintf(stderr,"%s: option -V requires option -H\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->share_cache && !options->model_counter) {
+    fprintf(stderr,"%s: option -S requires option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->shared_segment!=NULL && !options->share_cache) {
+    fprintf(stderr,"%s: option -Z requires option -S\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->shared_segment!=NULL && options->dynamic) {
+    fprintf(stderr,"%s: option -Z cannot be used with option -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->dynamic && !options->model_counter) {
+    fprintf(stderr,"%s: option -D requires option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->exact && !options->model_counter) {
+    fprintf(stderr,"%s: option -x requires option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->exact && (options->share_cache || options->dynamic)) {
+    fprintf(stderr,"%s: option -x cannot be used with options -S and -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->count_type!='d' && options->count_type!='l' && options->count_type!='e') {
+    fprintf(stderr,"%s: count type must be d, l or e\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->count_type!='d' && !options->model_counter) {
+    fprintf(stderr,"%s: option -N requires option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->count_type!='d' && (options->exact || options->share_cache || options->dynamic)) {
+    fprintf(stderr,"%s: option -N cannot be used with options -x, -S and -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->weights_filename!=NULL && !options->model_counter && options->nnf_queries_filename==NULL) {
+    fprintf(stderr,"%s: option -w requires option -W or -e\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->weights_filename!=NULL && (options->exact || options->share_cache || options->dynamic)) {
+    fprintf(stderr,"%s: option -w cannot be used with options -x, -S and -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->marginals_filename!=NULL && !options->model_counter) {
+    fprintf(stderr,"%s: option -g requires option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->marginals_filename!=NULL && (options->count_type!='d' || options->exact || options->share_cache || options->dynamic)) {
+    fprintf(stderr,"%s: option -g cannot be used with options -N, -x, -S and -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->queries_filename!=NULL && !options->model_counter) {
+    fprintf(stderr,"%s: option -q requires option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->queries_filename!=NULL && (options->count_type!='d' || options->exact || options->weights_filename!=NULL ||
+                                         options->marginals_filename!=NULL || options->dynamic)) {
+    fprintf(stderr,"%s: option -q cannot be used with options -N, -x, -w, -g and -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->projection_filename!=NULL && !options->model_counter) {
+    fprintf(stderr,"%s: option -P requires option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->projection_filename!=NULL && (options->count_type!='d' || options->exact || options->weights_filename!=NULL ||
+                                            options->marginals_filename!=NULL || options->queries_filename!=NULL ||
+                                            options->share_cache || options->dynamic)) {
+    fprintf(stderr,"%s: option -P cannot be used with options -N, -x, -w, -g, -q, -S and -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->jobs < 1) {
+    fprintf(stderr,"%s: option -j must be greater than 0\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->jobs > 1 && options->in_memory) {
+    fprintf(stderr,"%s: option -j cannot be used with option -i\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->jobs > 1 && (options->count_type!='d' || options->exact || options->weights_filename!=NULL ||
+                           options->marginals_filename!=NULL || options->projection_filename!=NULL || options->dynamic)) {
+    fprintf(stderr,"%s: option -j cannot be used with options -N, -x, -w, -g, -P and -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->cache_filename!=NULL && !options->model_counter) {
+    fprintf(stderr,"%s: option -K requires option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->cache_filename!=NULL && (options->count_type!='d' || options->exact || options->weights_filename!=NULL ||
+                                       options->marginals_filename!=NULL || options->projection_filename!=NULL ||
+                                       options->dynamic || options->jobs > 1)) {
+    fprintf(stderr,"%s: option -K cannot be used with options -N, -x, -w, -g, -P, -D and -j\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->checkpoint < 0) {
+    fprintf(stderr,"%s: option -T must be nonnegative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->checkpoint > 0 && options->cache_filename==NULL) {
+    fprintf(stderr,"%s: option -T requires option -K\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->learned_filename!=NULL && options->jobs > 1) {
+    fprintf(stderr,"%s: option -L cannot be used with option -j\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->learned_size < 0 || options->learned_lbd < 0) {
+    fprintf(stderr,"%s: options -l and -B must be nonnegative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if((options->learned_size > 0 || options->learned_lbd > 0) && options->learned_filename==NULL) {
+    fprintf(stderr,"%s: options -l and -B require option -L\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  BOOLEAN flat_nnf = options->nnf_queries_filename!=NULL || options->nnf_binary_filename!=NULL || options->nnf_text_filename!=NULL;
+  if(flat_nnf && (options->model_counter || options->in_memory)) {
+    fprintf(stderr,"%s: options -e, -O and -F cannot be used with options -W and -i\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->nnf_in_filename!=NULL && !flat_nnf) {
+    fprintf(stderr,"%s: option -n requires option -e, -O or -F\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  //the jobs of a count share the counts of residual cnfs (see split_vtree_tasks in parallel.c)
+  if(options->jobs > 1 && options->model_counter) options->share_cache = 1;
   return options;
 }
 
@@ -141,7 +363,7 @@ void print_help(const char* PACKAGE, int exit_value) {
   printf("%s: CNF to Decision-DNNF Compiler\n", PACKAGE);
   printf("%s\n",c2d_version());
 
-  printf("%s [-c .] [-v .] [-o .] [-d .] [-t .] [-m .] [-b .] [-u .] [-f .] [-s .]   [-i] [-E] [-C] [-W] [-h]\n", PACKAGE);
+  printf("%s [-c .] [-v .] [-o .] [-d .] [-t .] [-m .] [-b .] [-u .] [-f .] [-s .] [-M .] [-R .] [-H] [-V .] [-S] [-D] [-x] [-N .] [-w .] [-g .] [-q .] [-P .] [-j .] [-Z .] [-K .] [-T .] [-L .] [-l .] [-B .] [-e .] [-n .] [-O .] [-F .]   [-i] [-E] [-C] [-W] [-h]\n", PACKAGE);
    
 
   printf("  --cnf             -c FILE    set input CNF file\n");
@@ -165,12 +387,40 @@ void print_help(const char* PACKAGE, int exit_value) {
   printf("  --initial_ubfs    -u FACTOR  set start balance factor when using option -m 1 (default 25, must be between 1 and 49, inclusive)\n");
   printf("  --final_ubfs      -f FACTOR  set end balance factor when using   option -m 1 (default 25, must be between 1 and 49, inclusive)\n");
 
-  printf("  --cache_capacity  -s SIZE    set the hash table capacity for the vtree\n");
+  printf("  --cache_capacity  -s SIZE    set the initial hash table capacity for the vtree (grows as needed, default 65536)\n");
+  printf("  --cache_mem       -M SIZE    set the memory budget of the vtree cache in megabytes, evicting entries when it is reached (default 0: no budget)\n");
+  printf("  --min_hit_rate    -R RATE    switch caching off at a vtree node while fewer than RATE percent of its recent lookups hit, and retry it later (e.g., 1; default 0: never)\n");
+  printf("  --hash_keys       -H         store 128-bit fingerprints of keys in the vtree cache instead of the keys (a false hit is possible but unlikely)\n");
+  printf("  --verify_keys     -V RATE    with option -H, also store keys and check one in RATE fingerprint hits against them (default 0: no checks)\n");
+  printf("  --share_cache     -S         with option -W, share counts between vtree nodes whose residual CNFs are identical (same unsubsumed clauses and free variables)\n");
 
   printf("  --in_memory       -i         suppress the saving of compiled NNF to a file\n");
   printf("  --check_entail    -E         verify the compiled Decision-DNNF is correct by ensuring it is decomposable and also entails the input CNF\n");
   printf("  --count_models    -C         count the models of the input CNF after compiling it into a Decision-DNNF\n");
   printf("  --model_counter   -W         count the (weighted) models of the input CNF without compiling it into a Decision-DNNF\n");
+  printf("  --dynamic         -D         with option -W, count by splitting the residual CNF into connected components after each decision, instead of following a vtree\n");
+  printf("  --exact           -x         with option -W, count exactly using arbitrary precision (literal weights must be nonnegative integers)\n");
+  printf("  --count_type      -N TYPE    with option -W, set the representation of counts, which are never rounded to 0 or infinity unless it is d\n");
+  printf("                               d: double (default)\n");
+  printf("                               l: natural logarithm of a double\n");
+  printf("                               e: double mantissa with a 64-bit exponent\n");
+  printf("  --weights         -w FILE    with option -W or -e, count under each weight function in FILE (lines \"p weights K\", then \"literal w_1 ... w_K\"; default weight 1; a single function with options -N and -g)\n");
+  printf("  --marginals       -g FILE    with option -W, save the derivative of the count with respect to each literal weight, and the marginal of each literal, to FILE\n");
+  printf("  --queries         -q FILE    with option -W, then count under the evidence of each query in FILE (one line of literals ending in 0 per query, - for stdin), keeping the cache and learned clauses\n");
+  printf("  --projection      -P FILE    with option -W, count models projected on the variables of lines \"c p show v_1 ... v_k 0\" in FILE (e.g., the CNF)\n");
+  printf("  --jobs            -j COUNT   count (with option -W, which then implies option -S) or compile with COUNT processes, each working on parts of the vtree with its own copy of the sat state (default 1)\n");
+  printf("                               (the vtree is split into up to 4 tasks per process at decomposition nodes, but at Shannon nodes only until there is one task per process,\n");
+  printf("                               as the two tasks of a Shannon node repeat their common sub-problems: with Shannon nodes at its top, the processes do more work than one)\n");
+  printf("  --shared_segment  -Z NAME    with option -S, keep the counts of residual CNFs in the shared memory segment NAME (e.g., /c2d), reusing those of other processes counting the same CNF (the segment remains until removed from /dev/shm)\n");
+  printf("  --cache_file      -K FILE    with option -W, load the vtree cache and learned clauses from FILE if it was saved for the same CNF and vtree (e.g., given by option -v), and save them to FILE after counting, once interrupted, or on SIGUSR1 (hence, rerunning resumes an interrupted run)\n");
+  printf("  --checkpoint      -T SECONDS with option -K, also save FILE every SECONDS seconds while counting (default 0: never)\n");
+  printf("  --learned_file    -L FILE    add the learned clauses saved in FILE by a run on the same CNF (e.g., with another vtree), and save the learned clauses to FILE after counting or compiling\n");
+  printf("  --learned_size    -l SIZE    with option -L, save only learned clauses with at most SIZE literals (default 0: no limit)\n");
+  printf("  --learned_lbd     -B LBD     with option -L, save only learned clauses whose literals had at most LBD decision levels when learned (default 0: no limit)\n");
+  printf("  --nnf_queries     -e FILE    after compiling, evaluate the weighted count and max-product under the evidence of each query in FILE (as with option -q) on the saved Decision-DNNF\n");
+  printf("  --nnf_in          -n FILE    with option -e, -O or -F, load the Decision-DNNF in FILE (saved by compiling the CNF, or by option -O or -F) instead of compiling\n");
+  printf("  --nnf_binary_out  -O FILE    after compiling, save the smoothed Decision-DNNF to FILE in a binary format that option -n maps into memory without parsing\n");
+  printf("  --nnf_text_out    -F FILE    after compiling, save the smoothed Decision-DNNF to FILE in the nnf text format\n");
   printf("  --help            -h         print this help and exit\n");
   exit(exit_value);
 }
@@ -4,18 +4,75 @@
  * http://reasoning.cs.ucla.edu/c2d
  ******************************************************************************/
 
+#include <math.h>
 #include "c2d.h"
 
 //getopt.c
 c2dOptions* get_options(int argc, char** argv);
 //compile.c
-NnfManager* compile_vtree(VtreeManager* manager, SatState* sat_state);
+NnfNode* compile_vtree(VtreeManager* manager, UniqueNnf* nnf_manager, SatState* sat_state);
 //count.c
 c2dWmc count_vtree(VtreeManager* manager, SatState* sat_state);
+//count_exact.c
+char* count_vtree_exact(VtreeManager* manager, SatState* sat_state);
+//count_log.c
+c2dWmc count_vtree_log(const LiteralWeights* weights, VtreeManager* manager, SatState* sat_state);
+//count_ext.c
+c2dWmc count_vtree_ext(long* exponent, const LiteralWeights* weights, VtreeManager* manager, SatState* sat_state);
+//count_vector.c
+c2dWmc* count_vtree_vector(const LiteralWeights* weights, VtreeManager* manager, SatState* sat_state);
+//count_marginals.c
+c2dWmc count_vtree_marginals(c2dWmc* derivatives, const LiteralWeights* weights, VtreeManager* manager, SatState* sat_state);
+void save_marginals(const char* fname, c2dWmc count, const c2dWmc* derivatives, const LiteralWeights* weights, SatState* sat_state);
+//count_projected.c
+BOOLEAN* read_projection(const char* fname, const SatState* sat_state);
+char* save_projected_vtree(const DVtree* vtree, const BOOLEAN* projected);
+c2dWmc count_vtree_projected(const BOOLEAN* projected, VtreeManager* manager, SatState* sat_state);
+//count_parallel.c
+c2dWmc count_vtree_parallel(c2dSize jobs, VtreeManager* manager, SatState* sat_state);
+//compile_parallel.c
+void compile_vtree_parallel(c2dSize jobs, const char* fname, c2dSize* n_count, c2dSize* e_count, VtreeManager* manager, SatState* sat_state);
+//parallel.c
+void print_parallel_stats();
+double parallel_run_time();
+//evidence.c
+void count_queries(const char* fname, VtreeManager* manager, SatState* sat_state);
+//weights.c
+LiteralWeights* read_literal_weights(const char* fname, const SatState* sat_state);
+void free_literal_weights(LiteralWeights* weights);
+//nnf_eval.c
+FlatNnf* read_flat_nnf(const char* fname, c2dSize var_count);
+void free_flat_nnf(FlatNnf* nnf);
+BOOLEAN save_binary_flat_nnf(const char* fname, const FlatNnf* nnf);
+BOOLEAN save_text_flat_nnf(const char* fname, const FlatNnf* nnf);
+//nnf_unique.c
+UniqueNnf* new_unique_nnf(const SatState* sat_state);
+void free_unique_nnf(UniqueNnf* nnf);
+void save_unique_nnf(const char* fname, const NnfNode* root, const UniqueNnf* nnf, c2dSize* node_count, c2dSize* edge_count);
+NnfManager* unique_nnf_manager(const NnfNode* root, const UniqueNnf* nnf, const SatState* sat_state);
+c2dSize unique_nnf_memory(const UniqueNnf* nnf);
+void print_unique_nnf_stats(const UniqueNnf* nnf);
+void evaluate_nnf_queries(const char* fname, const FlatNnf* nnf, const LiteralWeights* weights, const SatState* sat_state);
+//count_dynamic.c
+c2dWmc count_dynamic(ComponentCache* components, SatState* sat_state);
+void print_dynamic_stats(const ComponentCache* components);
+//component.c
+ComponentCache* construct_component_cache();
+void open_component_segment(const char* name, c2dSize jobs, const SatState* sat_state, ComponentCache* components);
+void free_component_cache(ComponentCache* components);
 //cache.c
 void print_vtree_cache_stats(VtreeCache* vtree_cache);
+void set_vtree_cache_limit(c2dSize limit, VtreeCache* cache);
+void set_vtree_cache_min_hit_rate(double min_hit_rate, VtreeCache* cache);
+void set_vtree_cache_fingerprints(BOOLEAN hash_keys, c2dSize verify_keys, VtreeCache* cache);
+void share_vtree_cache(VtreeCache* cache);
+//cache_file.c
+BOOLEAN open_vtree_cache_file(const char* fname, VtreeManager* manager, SatState* sat_state);
+void set_cache_checkpoints(unsigned int period);
+c2dSize save_vtree_cache_file(VtreeManager* manager, const SatState* sat_state);
 //utilities.c
 void pprint_bytes(const char* string, c2dSize bytes);
+void pprint_log10_count(const char* string, long double log10_count);
 char* extended_file_name(const char* fname, const char* new_extension);
 const char* vtree_type(const c2dOptions* options);
 
@@ -23,6 +80,52 @@ const char* vtree_type(const c2dOptions* options);
  * start
  ******************************************************************************/
 
+//save the learned clauses of sat state to the file of option -L
+static void save_learned_clauses(const c2dOptions* options, const SatState* sat_state) {
+  c2dSize count;
+  printf("\nSaving learned clauses...");
+  if(!sat_save_learned_clauses(options->learned_filename,options->learned_size,options->learned_lbd,&count,sat_state)) {
+    fprintf(stderr,"\nc2D: cannot write learned clauses to %s\n",options->learned_filename);
+    exit(1);
+  }
+  printf(" DONE (%"PRIvS" clauses)",count);
+}
+
+//load the Decision-DNNF in the (text or binary) nnf file fname, save it for options -O and -F,
+//and evaluate the queries of option -e on it
+static void process_nnf_file(const char* fname, const c2dOptions* options, const LiteralWeights* weights, const SatState* sat_state) {
+  clock_t start_t = clock();
+  printf("\nLoading flat NNF...");
+  FlatNnf* nnf = read_flat_nnf(fname,sat_var_count(sat_state));
+  if(nnf==NULL) {
+    fprintf(stderr,"\nc2D: cannot read nnf file %s (for this CNF)\n",fname);
+    exit(1);
+  }
+  printf(" DONE%s",nnf->mapping!=NULL? " (binary)": "");
+  printf("\n  Nodes           \t%"PRIvS" (%"PRIvS" added by smoothing)",nnf->node_count,nnf->added_count);
+  printf("\n  Edges           \t%"PRIvS"",nnf->edge_count);
+  printf("\n  Node Bytes      \t%"PRIvS"",nnf->node_bytes);
+  printf("\n  Load Time       \t%0.3fs",((double)clock()-start_t)/CLOCKS_PER_SEC);
+  if(options->nnf_binary_filename!=NULL) {
+    printf("\nSaving binary NNF...");
+    if(!save_binary_flat_nnf(options->nnf_binary_filename,nnf)) {
+      fprintf(stderr,"\nc2D: cannot write nnf file %s\n",options->nnf_binary_filename);
+      exit(1);
+    }
+    printf(" DONE");
+  }
+  if(options->nnf_text_filename!=NULL) {
+    printf("\nSaving text NNF...");
+    if(!save_text_flat_nnf(options->nnf_text_filename,nnf)) {
+      fprintf(stderr,"\nc2D: cannot write nnf file %s\n",options->nnf_text_filename);
+      exit(1);
+    }
+    printf(" DONE");
+  }
+  if(options->nnf_queries_filename!=NULL) evaluate_nnf_queries(options->nnf_queries_filename,nnf,weights,sat_state);
+  free_flat_nnf(nnf);
+}
+
 int main(int argc, char* argv[]) {
 
   //get options from command line (and defaults)
@@ -43,17 +146,102 @@ int main(int argc, char* argv[]) {
   printf("\n  Vars=%"PRIvS" / ",sat_var_count(sat_state));
   printf("Clauses=%"PRIvS"",sat_clause_count(sat_state));
   printf("\n  CNF Time\t%0.3fs",((double)(sat_t))/CLOCKS_PER_SEC);
+  if(options->learned_filename!=NULL) {
+    c2dSize count;
+    printf("\nLoading learned clauses...");
+    if(sat_load_learned_clauses(options->learned_filename,&count,sat_state)) printf(" DONE (%"PRIvS" clauses)",count);
+    else printf(" IGNORED (saved for another CNF)");
+  }
+
+  //(weighted) model counting by dynamic decomposition (no vtree is needed)
+  if(options->dynamic) {
+    start_t = clock();
+    printf("\nCounting (dynamic decomposition)..."); fflush(stdout);
+    ComponentCache* components = construct_component_cache();
+    c2dWmc count = count_dynamic(components,sat_state);
+    clock_t count_t = clock()-start_t;
+    printf(" DONE");
+    printf("\n  Learned clauses      \t%"PRIvS"",sat_learned_clause_count(sat_state));
+    print_dynamic_stats(components);
+    printf("\nCount stats:");
+    printf("\n  Count Time\t%0.3fs",((double)(count_t))/CLOCKS_PER_SEC);
+    printf("\n  Count \t%0.3"PRIwmcS"",count);
+    if(options->learned_filename!=NULL) save_learned_clauses(options,sat_state);
+    printf("\nTotal Time: %0.3fs\n\n",((double)clock()-start_total_t)/CLOCKS_PER_SEC);
+    free_component_cache(components);
+    free(options);
+    sat_state_free(sat_state);
+    return 0;
+  }
+
+  //read literal weights
+  LiteralWeights* weights = NULL;
+  if(options->weights_filename!=NULL) {
+    weights = read_literal_weights(options->weights_filename,sat_state);
+    if(weights==NULL) {
+      fprintf(stderr,"\nc2D: cannot read literal weights from %s\n",options->weights_filename);
+      exit(1);
+    }
+    printf("\n  Weight functions\t%"PRIvS"",weights->count);
+    if(options->marginals_filename!=NULL && weights->count>1) {
+      fprintf(stderr,"\nc2D: option -g requires a single weight function\n");
+      exit(1);
+    }
+    if(options->count_type!='d' && weights->count>1) {
+      fprintf(stderr,"\nc2D: option -N requires a single weight function\n");
+      exit(1);
+    }
+  }
+
+  //evaluating or converting a Decision-DNNF saved by an earlier run (no vtree is needed)
+  if(options->nnf_in_filename!=NULL) {
+    process_nnf_file(options->nnf_in_filename,options,weights,sat_state);
+    printf("\nTotal Time: %0.3fs\n\n",((double)clock()-start_total_t)/CLOCKS_PER_SEC);
+    if(weights!=NULL) free_literal_weights(weights);
+    free(options);
+    sat_state_free(sat_state);
+    return 0;
+  }
+
+  //projected counting: the vtree puts projection variables above existential ones
+  BOOLEAN* projected = NULL;
+  char* projected_vtree_filename = NULL;
+  if(options->projection_filename!=NULL) {
+    projected = read_projection(options->projection_filename,sat_state);
+    if(projected==NULL) {
+      fprintf(stderr,"\nc2D: cannot read projection variables from %s\n",options->projection_filename);
+      exit(1);
+    }
+    printf("\nConstructing projected vtree (from %s)...",vtree_type(options)); fflush(stdout);
+    VtreeManager* order_manager = vtree_manager_new(sat_state,options);
+    projected_vtree_filename    = save_projected_vtree(order_manager->vtree,projected);
+    vtree_manager_free(order_manager);
+    options->vtree_in_filename  = projected_vtree_filename;
+    printf(" DONE");
+  }
 
   //construct Vtree
   start_t = clock();
   printf("\nConstructing vtree (from %s)...",vtree_type(options)); fflush(stdout);
   manager = vtree_manager_new(sat_state,options);
+  if(projected_vtree_filename!=NULL) remove(projected_vtree_filename);
   clock_t vtree_t = clock()-start_t;
   printf(" DONE");
   printf("\nVtree stats:");
   printf("\n  "); vtree_print_widths(manager->vtree);
   printf("\n  Vtree Time\t%0.3fs",((double)(vtree_t))/CLOCKS_PER_SEC);
   fflush(stdout);
+  set_vtree_cache_limit((c2dSize)options->cache_memory*1024*1024,manager->cache);
+  set_vtree_cache_min_hit_rate(options->min_hit_rate/100,manager->cache);
+  set_vtree_cache_fingerprints(options->hash_keys,options->verify_keys,manager->cache);
+  if(options->share_cache) share_vtree_cache(manager->cache);
+  if(options->shared_segment!=NULL) open_component_segment(options->shared_segment,options->jobs,sat_state,manager->cache->components);
+  if(options->cache_filename!=NULL) {
+    printf("\nLoading cache...");
+    if(open_vtree_cache_file(options->cache_filename,manager,sat_state)) printf(" DONE (%"PRIvS" entries)",manager->cache->saved->count);
+    else printf(" IGNORED (saved for another CNF or vtree)");
+    if(options->checkpoint) set_cache_checkpoints(options->checkpoint);
+  }
 
   if(options->vtree_out_filename!=NULL) {
     printf("\nSaving vtree...");
@@ -70,46 +258,120 @@ int main(int argc, char* argv[]) {
   if(options->model_counter) {
     start_t = clock();
     printf("\nCounting..."); fflush(stdout);
-    c2dWmc count = count_vtree(manager,sat_state);
-    clock_t count_t = clock()-start_t;
+    c2dWmc count = 0;
+    char* exact_count = NULL;
+    c2dWmc* counts    = NULL; //one count per weight function
+    c2dWmc* derivatives = NULL; //derivatives[var_count+l] is the derivative wrt the weight of literal l
+    long double log10_count = 0; //used when counts are not represented by doubles
+    if(options->exact) {
+      exact_count = count_vtree_exact(manager,sat_state);
+      if(exact_count==NULL) {
+        fprintf(stderr,"\nc2D: option -x requires literal weights that are nonnegative integers\n");
+        exit(1);
+      }
+    }
+    else if(options->marginals_filename!=NULL) {
+      derivatives = (c2dWmc*) malloc((2*sat_var_count(sat_state)+1)*sizeof(c2dWmc));
+      count = count_vtree_marginals(derivatives+sat_var_count(sat_state),weights,manager,sat_state);
+    }
+    else if(weights!=NULL && options->count_type=='d') counts = count_vtree_vector(weights,manager,sat_state);
+    else if(projected!=NULL) count = count_vtree_projected(projected,manager,sat_state);
+    else if(options->count_type=='l') log10_count = count_vtree_log(weights,manager,sat_state)/logl(10);
+    else if(options->count_type=='e') {
+      long exponent;
+      c2dWmc mantissa = count_vtree_ext(&exponent,weights,manager,sat_state);
+      log10_count = mantissa==0? -INFINITY: log10l(mantissa)+exponent*log10l(2);
+    }
+    else if(options->jobs>1) count = count_vtree_parallel(options->jobs,manager,sat_state);
+    else count = count_vtree(manager,sat_state);
+    //with option -j, the count is done by other processes: its time is the wall time
+    double count_time = options->jobs>1? parallel_run_time(): ((double)(clock()-start_t))/CLOCKS_PER_SEC;
     printf(" DONE");
     printf("\n  Learned clauses      \t%"PRIvS"",sat_learned_clause_count(sat_state));
     print_vtree_cache_stats(manager->cache);
+    if(options->jobs>1) print_parallel_stats();
     printf("\nCount stats:");
-    printf("\n  Count Time\t%0.3fs",((double)(count_t))/CLOCKS_PER_SEC);
-    printf("\n  Count \t%0.3"PRIwmcS"",count);
+    printf("\n  Count Time\t%0.3fs",count_time);
+    if(exact_count!=NULL) printf("\n  Count \t%s",exact_count);
+    else if(counts!=NULL) {
+      for(c2dSize j=0; j<weights->count; j++) printf("\n  Count %"PRIvS" \t%0.3"PRIwmcS"",j+1,counts[j]);
+    }
+    else if(options->count_type!='d') pprint_log10_count("\n  Count \t",log10_count);
+    else printf("\n  Count \t%0.3"PRIwmcS"",count);
+    if(derivatives!=NULL) {
+      printf("\nSaving marginals...");
+      save_marginals(options->marginals_filename,count,derivatives+sat_var_count(sat_state),weights,sat_state);
+      printf(" DONE");
+      free(derivatives);
+    }
+    if(options->queries_filename!=NULL) count_queries(options->queries_filename,manager,sat_state);
+    if(options->cache_filename!=NULL) {
+      printf("\nSaving cache...");
+      c2dSize count = save_vtree_cache_file(manager,sat_state);
+      printf(" DONE (%"PRIvS" entries)",count);
+    }
+    if(options->learned_filename!=NULL) save_learned_clauses(options,sat_state);
     printf("\nTotal Time: %0.3fs\n\n",((double)clock()-start_total_t)/CLOCKS_PER_SEC);
+    free(exact_count);
+    free(counts);
+    free(projected);
+    free(projected_vtree_filename);
+    if(weights!=NULL) free_literal_weights(weights);
     free(options);
     vtree_manager_free(manager);
     sat_state_free(sat_state);
     return 0;
   }
 
-  //compile CNF into a Decision-DNNF
-  start_t = clock();
-  printf("\nCompiling..."); fflush(stdout);
-  NnfManager* nnf_manager = compile_vtree(manager,sat_state);
-  clock_t comp_t = clock()-start_t;
-  printf(" DONE");
-  pprint_bytes("\n  NNF memory      \t",nnf_manager_memory(nnf_manager));
-  printf("\n  Learned clauses      \t%"PRIvS"",sat_learned_clause_count(sat_state));
-  print_vtree_cache_stats(manager->cache);
-  printf("\n  Compile Time\t%0.3fs",((double)(comp_t))/CLOCKS_PER_SEC);
-	
   char* nnf_fname = extended_file_name(options->cnf_filename,".nnf");
+  NnfManager* nnf_manager = NULL;
 
-  if(options->in_memory==0) { //save NNF to file
+  if(options->jobs>1) { //compile CNF into a Decision-DNNF in parallel (which is saved to file)
     start_t = clock();
-    printf("\nSaving compiled NNF to file...");
+    printf("\nCompiling..."); fflush(stdout);
     c2dSize n_count, e_count;
-    nnf_manager_save_to_file(nnf_fname,nnf_manager,&n_count,&e_count);
+    compile_vtree_parallel(options->jobs,nnf_fname,&n_count,&e_count,manager,sat_state);
+    double comp_time = parallel_run_time(); //wall time (jobs compile in other processes)
     printf(" DONE");
-    printf("\n  Save Time       \t%0.3fs",((double)clock()-start_t)/CLOCKS_PER_SEC);
+    print_parallel_stats();
+    printf("\n  Compile Time\t%0.3fs",comp_time);
     printf("\nNNF stats:");
     printf("\n  Nodes           \t%"PRIvS"",n_count);
     printf("\n  Edges           \t%"PRIvS"",e_count);
-    nnf_manager_free(nnf_manager); //manager should be freed as NNF destroyed
   }
+  else {
+    //compile CNF into a Decision-DNNF
+    start_t = clock();
+    printf("\nCompiling..."); fflush(stdout);
+    UniqueNnf* unique_nnf = new_unique_nnf(sat_state);
+    NnfNode* root = compile_vtree(manager,unique_nnf,sat_state);
+    if(options->in_memory) nnf_manager = unique_nnf_manager(root,unique_nnf,sat_state);
+    clock_t comp_t = clock()-start_t;
+    printf(" DONE");
+    pprint_bytes("\n  NNF memory      \t",unique_nnf_memory(unique_nnf));
+    printf("\n  Learned clauses      \t%"PRIvS"",sat_learned_clause_count(sat_state));
+    print_vtree_cache_stats(manager->cache);
+    print_unique_nnf_stats(unique_nnf);
+    printf("\n  Compile Time\t%0.3fs",((double)(comp_t))/CLOCKS_PER_SEC);
+    if(options->learned_filename!=NULL) save_learned_clauses(options,sat_state);
+
+    if(options->in_memory==0) { //save NNF to file
+      start_t = clock();
+      printf("\nSaving compiled NNF to file...");
+      c2dSize n_count, e_count;
+      save_unique_nnf(nnf_fname,root,unique_nnf,&n_count,&e_count);
+      printf(" DONE");
+      printf("\n  Save Time       \t%0.3fs",((double)clock()-start_t)/CLOCKS_PER_SEC);
+      printf("\nNNF stats:");
+      printf("\n  Nodes           \t%"PRIvS"",n_count);
+      printf("\n  Edges           \t%"PRIvS"",e_count);
+    }
+    free_unique_nnf(unique_nnf);
+  }
+  if(options->nnf_queries_filename!=NULL || options->nnf_binary_filename!=NULL || options->nnf_text_filename!=NULL) {
+    process_nnf_file(nnf_fname,options,weights,sat_state);
+  }
+  if(weights!=NULL) free_literal_weights(weights);
 
   Nnf* nnf = NULL;
   if(options->count_models || options->check_entail) { //further processing is needed
@@ -0,0 +1,686 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _DEFAULT_SOURCE //posix_memalign and mmap
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "c2d.h"
+
+//evidence.c
+BOOLEAN read_query(FILE* file, c2dLiteral** evidence, c2dSize* size, c2dSize* capacity, c2dSize var_count);
+
+/******************************************************************************
+ * evaluating a Decision-DNNF saved to an nnf file, without the nnf manager
+ *
+ * the nodes of the file are loaded into flat arrays (see FlatNnf in c2d.h), in the
+ * order of the file, which lists children before their parents. an evaluation is
+ * then one linear sweep over these arrays, computing for each node its weighted
+ * count (a sum at or-nodes) and its max-product (a max at or-nodes). children are
+ * stored as varint deltas from their parents, which are mostly one or two bytes
+ *
+ * both require a smooth nnf, where the children of an or-node mention the same
+ * variables, which Decision-DNNFs need not be. hence, while loading, a child that
+ * misses variables v of its or-node is conjoined with (v or -v) for each of them
+ * (one or-node per variable, shared by all children), and so is the root for the
+ * cnf variables it misses
+ *
+ * a flat nnf can be saved to a binary file (see BinaryNnfHeader), which is mapped
+ * into memory and evaluated in place, so it is loaded without parsing. it can also
+ * be saved to a text nnf file, as a smoothed Decision-DNNF
+ *
+ * a sweep evaluates VECTOR_WIDTH lanes at once, one lane per pair of a query (its
+ * evidence sets the weights of the opposite literals to 0) and a weight function,
+ * so many queries under one weight function are answered in one sweep
+ ******************************************************************************/
+
+#define VECTOR_WIDTH 8
+
+typedef c2dWmc c2dWmcVector __attribute__((vector_size(VECTOR_WIDTH*sizeof(c2dWmc))));
+typedef long c2dMaskVector __attribute__((vector_size(VECTOR_WIDTH*sizeof(long))));
+
+//the weighted count and max-product of a node (side by side, as both are computed by a sweep)
+typedef struct {
+  c2dWmcVector count;
+  c2dWmcVector max;
+} NodeValue;
+
+//max = the lane-wise max of max and b (vectors are passed by pointer, like structures)
+static inline void vector_max(c2dWmcVector* max, const c2dWmcVector* b) {
+  c2dMaskVector greater = *max > *b;
+  *max = (c2dWmcVector) (((c2dMaskVector)*max & greater) | ((c2dMaskVector)*b & ~greater));
+}
+
+/******************************************************************************
+ * varints
+ ******************************************************************************/
+
+static inline BYTE* write_varint(c2dSize value, BYTE* bytes) {
+  while(value>=0x80) {
+    *bytes++ = (BYTE)(value|0x80);
+    value >>= 7;
+  }
+  *bytes++ = (BYTE)value;
+  return bytes;
+}
+
+static inline c2dSize read_varint(const BYTE** bytes) {
+  c2dSize value = 0;
+  int shift     = 0;
+  BYTE byte;
+  do {
+    byte   = *(*bytes)++;
+    value |= (c2dSize)(byte&0x7F)<<shift;
+    shift += 7;
+  } while(byte&0x80);
+  return value;
+}
+
+//literals are zigzag encoded (0,-1,1,-2,... as 0,1,2,3,...) so that they take few bytes
+static inline c2dSize zigzag(c2dLiteral literal) {
+  return ((c2dSize)literal<<1) ^ (c2dSize)(literal>>63);
+}
+
+static inline c2dLiteral unzigzag(c2dSize value) {
+  return (c2dLiteral)(value>>1) ^ -(c2dLiteral)(value&1);
+}
+
+/******************************************************************************
+ * loading and smoothing
+ ******************************************************************************/
+
+//nodes of the nnf file (as read)
+typedef struct {
+  c2dSize node_count;
+  char* types;
+  c2dLiteral* literals; //literal of an 'L' node, decision variable of an 'O' node
+  c2dSize* offsets;
+  c2dSize* children;
+} NnfFile;
+
+static void malformed_nnf_file(const char* fname) {
+  fprintf(stderr,"\nc2D: malformed nnf file %s\n",fname);
+  exit(1);
+}
+
+//returns 0 if the file cannot be read, or mentions more than var_count variables
+static BOOLEAN read_nnf_file(const char* fname, c2dSize var_count, NnfFile* nnf) {
+  FILE* file = fopen(fname,"r");
+  c2dSize n_count, e_count, file_var_count;
+  if(file==NULL) return 0;
+  if(fscanf(file," nnf %"PRIvS" %"PRIvS" %"PRIvS"",&n_count,&e_count,&file_var_count)!=3 || file_var_count>var_count) {
+    fclose(file);
+    return 0;
+  }
+  nnf->node_count = n_count;
+  nnf->types      = (char*) malloc(n_count*sizeof(char));
+  nnf->literals   = (c2dLiteral*) calloc(n_count,sizeof(c2dLiteral));
+  nnf->offsets    = (c2dSize*) malloc((n_count+1)*sizeof(c2dSize));
+  nnf->children   = (c2dSize*) malloc(e_count*sizeof(c2dSize));
+
+  c2dSize edges = 0;
+  for(c2dSize i=0; i<n_count; i++) {
+    char type;
+    long var;
+    c2dSize size = 0;
+    BOOLEAN ok = fscanf(file," %c",&type)==1;
+    if(ok && type=='L') ok = fscanf(file,"%ld",&var)==1 && var!=0 && (c2dSize)labs(var)<=var_count;
+    else if(ok && type=='A') ok = fscanf(file,"%"PRIvS"",&size)==1;
+    else if(ok && type=='O') ok = fscanf(file,"%ld %"PRIvS"",&var,&size)==2;
+    else ok = 0;
+    ok = ok && edges+size<=e_count;
+    nnf->types[i]   = type;
+    nnf->offsets[i] = edges;
+    if(ok && type!='A') nnf->literals[i] = var;
+    for(c2dSize j=0; ok && j<size; j++) {
+      ok = fscanf(file,"%"PRIvS"",nnf->children+edges)==1 && nnf->children[edges]<i; //children come first
+      ++edges;
+    }
+    if(!ok) malformed_nnf_file(fname);
+  }
+  nnf->offsets[n_count] = edges;
+  fclose(file);
+  if(n_count==0) malformed_nnf_file(fname);
+  return 1;
+}
+
+static void free_nnf_file(NnfFile* nnf) {
+  free(nnf->types);
+  free(nnf->literals);
+  free(nnf->offsets);
+  free(nnf->children);
+}
+
+//a flat nnf under construction (nodes as in NnfFile), with the nodes shared by smoothing
+typedef struct {
+  c2dSize var_count;
+  c2dSize node_count;
+  c2dSize node_capacity;
+  c2dSize edge_capacity;
+  char* types;
+  c2dLiteral* literals;
+  c2dSize* offsets;
+  c2dSize* children;
+  c2dSize* literal_nodes; //literal_nodes[var_count+l] is 1+the node of literal l (0 if none)
+  c2dSize* var_nodes;     //var_nodes[v] is 1+the node (v or -v) (0 if none)
+} FlatNnfBuilder;
+
+static c2dSize add_flat_node(char type, c2dLiteral literal, const c2dSize* children, c2dSize size, FlatNnfBuilder* builder) {
+  if(builder->node_count==builder->node_capacity) {
+    builder->node_capacity *= 2;
+    builder->types    = (char*) realloc(builder->types,builder->node_capacity*sizeof(char));
+    builder->literals = (c2dLiteral*) realloc(builder->literals,builder->node_capacity*sizeof(c2dLiteral));
+    builder->offsets  = (c2dSize*) realloc(builder->offsets,(builder->node_capacity+1)*sizeof(c2dSize));
+  }
+  c2dSize edges = builder->offsets[builder->node_count];
+  while(edges+size>builder->edge_capacity) {
+    builder->edge_capacity *= 2;
+    builder->children = (c2dSize*) realloc(builder->children,builder->edge_capacity*sizeof(c2dSize));
+  }
+  if(size) memcpy(builder->children+edges,children,size*sizeof(c2dSize));
+  c2dSize node = builder->node_count++;
+  builder->types[node]     = type;
+  builder->literals[node]  = literal;
+  builder->offsets[node+1] = edges+size;
+  return node;
+}
+
+static c2dSize literal_node(c2dLiteral literal, FlatNnfBuilder* builder) {
+  c2dSize* node = builder->literal_nodes+builder->var_count+literal;
+  if(*node==0) *node = 1+add_flat_node('L',literal,NULL,0,builder);
+  return *node-1;
+}
+
+//returns the node (v or -v)
+static c2dSize var_node(c2dSize var, FlatNnfBuilder* builder) {
+  c2dSize* node = builder->var_nodes+var;
+  if(*node==0) {
+    c2dSize literals[2] = { literal_node(var,builder), literal_node(-(c2dLiteral)var,builder) };
+    *node = 1+add_flat_node('O',var,literals,2,builder);
+  }
+  return *node-1;
+}
+
+//returns node, conjoined with (v or -v) for each variable v in vars but not in node_vars
+static c2dSize smooth_node(c2dSize node, const unsigned long* node_vars, const unsigned long* vars, c2dSize words, c2dSize** buffer, c2dSize* capacity, FlatNnfBuilder* builder) {
+  c2dSize size = 0;
+  for(c2dSize w=0; w<words; w++) {
+    unsigned long missing = vars[w] & ~node_vars[w];
+    while(missing) {
+      c2dSize var = w*SAT_WORD_BITS+__builtin_ctzl(missing);
+      missing &= missing-1;
+      if(size+2>*capacity) {
+        *capacity *= 2;
+        *buffer = (c2dSize*) realloc(*buffer,*capacity*sizeof(c2dSize));
+      }
+      (*buffer)[++size] = var_node(var,builder);
+    }
+  }
+  if(size==0) return node;
+  (*buffer)[0] = node;
+  return add_flat_node('A',0,*buffer,size+1,builder);
+}
+
+//returns the flat nnf of the nodes of builder (which are freed)
+static FlatNnf* encode_flat_nnf(FlatNnfBuilder* builder) {
+  FlatNnf* nnf    = (FlatNnf*) calloc(1,sizeof(FlatNnf));
+  nnf->var_count  = builder->var_count;
+  nnf->node_count = builder->node_count;
+  nnf->edge_count = builder->offsets[builder->node_count];
+  //a varint takes at most 10 bytes
+  BYTE* nodes = (BYTE*) malloc(10*(2*nnf->node_count+nnf->edge_count));
+  BYTE* bytes = nodes;
+  for(c2dSize i=0; i<nnf->node_count; i++) {
+    if(builder->types[i]=='L') {
+      bytes = write_varint(zigzag(builder->literals[i]),bytes);
+      continue;
+    }
+    if(builder->types[i]=='O') bytes = write_varint(builder->literals[i],bytes);
+    bytes = write_varint(builder->offsets[i+1]-builder->offsets[i],bytes);
+    for(c2dSize e=builder->offsets[i]; e<builder->offsets[i+1]; e++) bytes = write_varint(i-builder->children[e],bytes);
+  }
+  nnf->node_bytes = bytes-nodes;
+  nnf->nodes      = (BYTE*) realloc(nodes,nnf->node_bytes+1);
+  nnf->types      = (char*) realloc(builder->types,nnf->node_count*sizeof(char));
+  free(builder->literals);
+  free(builder->offsets);
+  free(builder->children);
+  return nnf;
+}
+
+//returns the smoothed nnf of the text nnf file fname for a cnf with var_count variables,
+//or NULL if the file cannot be read or mentions more variables
+static FlatNnf* read_text_flat_nnf(const char* fname, c2dSize var_count) {
+  NnfFile file;
+  if(!read_nnf_file(fname,var_count,&file)) return NULL;
+  c2dSize n_count = file.node_count;
+
+  FlatNnfBuilder builder = { var_count, 0, n_count+1, file.offsets[n_count]+1 };
+  builder.types         = (char*) malloc(builder.node_capacity*sizeof(char));
+  builder.literals      = (c2dLiteral*) malloc(builder.node_capacity*sizeof(c2dLiteral));
+  builder.offsets       = (c2dSize*) malloc((builder.node_capacity+1)*sizeof(c2dSize));
+  builder.children      = (c2dSize*) malloc(builder.edge_capacity*sizeof(c2dSize));
+  builder.offsets[0]    = 0;
+  builder.literal_nodes = (c2dSize*) calloc(2*var_count+1,sizeof(c2dSize));
+  builder.var_nodes     = (c2dSize*) calloc(var_count+1,sizeof(c2dSize));
+
+  //the variables of a node are kept (as a bitset) until its last parent is loaded
+  c2dSize words     = var_count/SAT_WORD_BITS+1;
+  c2dSize* parents  = (c2dSize*) calloc(n_count,sizeof(c2dSize));
+  c2dSize* nodes    = (c2dSize*) malloc(n_count*sizeof(c2dSize)); //node of the flat nnf
+  unsigned long** vars = (unsigned long**) malloc(n_count*sizeof(unsigned long*));
+  for(c2dSize e=0; e<file.offsets[n_count]; e++) ++parents[file.children[e]];
+  ++parents[n_count-1]; //root
+  c2dSize capacity = 64;
+  c2dSize* children = (c2dSize*) malloc(capacity*sizeof(c2dSize));
+  c2dSize* smoothed = (c2dSize*) malloc(capacity*sizeof(c2dSize));
+  c2dSize smoothed_capacity = capacity;
+
+  for(c2dSize i=0; i<n_count; i++) {
+    c2dSize first = file.offsets[i];
+    c2dSize size  = file.offsets[i+1]-first;
+    vars[i] = (unsigned long*) calloc(words,sizeof(unsigned long));
+    if(file.types[i]=='L') {
+      c2dSize var = labs(file.literals[i]);
+      vars[i][var/SAT_WORD_BITS] |= 1UL<<(var%SAT_WORD_BITS);
+      nodes[i] = literal_node(file.literals[i],&builder);
+      if(parents[i]==0) free(vars[i]); //no parents
+      continue;
+    }
+    for(c2dSize j=0; j<size; j++) {
+      const unsigned long* child_vars = vars[file.children[first+j]];
+      for(c2dSize w=0; w<words; w++) vars[i][w] |= child_vars[w];
+    }
+    if(size>capacity) {
+      capacity = size;
+      children = (c2dSize*) realloc(children,capacity*sizeof(c2dSize));
+    }
+    for(c2dSize j=0; j<size; j++) {
+      c2dSize child = file.children[first+j];
+      if(file.types[i]=='O') children[j] = smooth_node(nodes[child],vars[child],vars[i],words,&smoothed,&smoothed_capacity,&builder);
+      else children[j] = nodes[child];
+    }
+    nodes[i] = add_flat_node(file.types[i],file.literals[i],children,size,&builder);
+    for(c2dSize j=0; j<size; j++) {
+      c2dSize child = file.children[first+j];
+      if(--parents[child]==0) free(vars[child]);
+    }
+    if(parents[i]==0) free(vars[i]); //no parents
+  }
+  //the root, with the cnf variables it misses
+  unsigned long* all_vars = (unsigned long*) calloc(words,sizeof(unsigned long));
+  for(c2dSize v=1; v<=var_count; v++) all_vars[v/SAT_WORD_BITS] |= 1UL<<(v%SAT_WORD_BITS);
+  c2dSize root = smooth_node(nodes[n_count-1],vars[n_count-1],all_vars,words,&smoothed,&smoothed_capacity,&builder);
+  if(root!=builder.node_count-1) root = add_flat_node('A',0,&root,1,&builder); //the root must be last
+  FlatNnf* nnf = encode_flat_nnf(&builder);
+  nnf->added_count = nnf->node_count-n_count;
+
+  free(all_vars);
+  free(vars[n_count-1]);
+  free(vars);
+  free(nodes);
+  free(parents);
+  free(children);
+  free(smoothed);
+  free(builder.literal_nodes);
+  free(builder.var_nodes);
+  free_nnf_file(&file);
+  return nnf;
+}
+
+/******************************************************************************
+ * files
+ ******************************************************************************/
+
+//a binary nnf file has this header, followed by the types and nodes of a flat nnf, each
+//starting at a multiple of BINARY_NNF_ALIGNMENT. numbers are in the byte order of the
+//machine that saved the file
+typedef struct {
+  char magic[8];        //BINARY_NNF_MAGIC
+  c2dSize byte_order;   //BINARY_NNF_BYTE_ORDER
+  c2dSize var_count;
+  c2dSize node_count;
+  c2dSize edge_count;
+  c2dSize added_count;
+  c2dSize types;        //offset of types
+  c2dSize nodes;        //offset of nodes
+  c2dSize node_bytes;
+} BinaryNnfHeader;
+
+#define BINARY_NNF_MAGIC "c2Dbnnf1"
+#define BINARY_NNF_BYTE_ORDER 0x0102030405060708UL
+#define BINARY_NNF_ALIGNMENT 64
+
+static inline c2dSize aligned_offset(c2dSize offset) {
+  return (offset+BINARY_NNF_ALIGNMENT-1)/BINARY_NNF_ALIGNMENT*BINARY_NNF_ALIGNMENT;
+}
+
+//reads a varint that ends before end (and fits in a c2dSize) into value
+//returns 0 if there is no such varint
+static BOOLEAN read_bounded_varint(const BYTE** bytes, const BYTE* end, c2dSize* value) {
+  *value = 0;
+  for(int shift=0; shift<64 && *bytes<end; shift+=7) {
+    BYTE byte = *(*bytes)++;
+    *value |= (c2dSize)(byte&0x7F)<<shift;
+    if(!(byte&0x80)) return 1;
+  }
+  return 0;
+}
+
+//returns 1 if the nodes of nnf are well formed, as evaluating them does not check: each
+//node is of type 'L', 'A' or 'O' with fields that end within its node bytes, the literal 
+//of an 'L' node and the decision variable of an 'O' node are of its variables, each child 
+//comes before its parent, and the fields of the root end at the end of its node bytes
+static BOOLEAN valid_flat_nnf(const FlatNnf* nnf) {
+  const BYTE* bytes = nnf->nodes;
+  const BYTE* end   = nnf->nodes+nnf->node_bytes;
+  c2dSize edges     = 0;
+  c2dSize value, size;
+  for(c2dSize i=0; i<nnf->node_count; i++) {
+    char type = nnf->types[i];
+    if(type=='L') {
+      if(!read_bounded_varint(&bytes,end,&value) || value==0 || (value>>1)+(value&1)>nnf->var_count) return 0;
+      continue;
+    }
+    if(type!='A' && type!='O') return 0;
+    if(type=='O' && (!read_bounded_varint(&bytes,end,&value) || value>nnf->var_count)) return 0;
+    if(!read_bounded_varint(&bytes,end,&size)) return 0;
+    for(c2dSize k=0; k<size; k++) {
+      if(!read_bounded_varint(&bytes,end,&value) || value==0 || value>i) return 0; //i-child
+    }
+    edges += size;
+  }
+  return bytes==end && edges==nnf->edge_count;
+}
+
+//returns the flat nnf of the binary nnf file fname, mapped into memory, or NULL if it
+//cannot be mapped, is malformed or was saved for a cnf with another variable count
+static FlatNnf* map_flat_nnf(const char* fname, c2dSize var_count) {
+  int fd = open(fname,O_RDONLY);
+  struct stat st;
+  if(fd<0) return NULL;
+  if(fstat(fd,&st)!=0 || (c2dSize)st.st_size<sizeof(BinaryNnfHeader)) {
+    close(fd);
+    return NULL;
+  }
+  void* mapping = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(mapping==MAP_FAILED) return NULL;
+
+  const BinaryNnfHeader* header = (const BinaryNnfHeader*) mapping;
+  c2dSize size = st.st_size;
+  if(memcmp(header->magic,BINARY_NNF_MAGIC,sizeof(header->magic)) || header->byte_order!=BINARY_NNF_BYTE_ORDER ||
+     header->var_count!=var_count || header->node_count==0 ||
+     header->types>size || header->node_count>size-header->types ||
+     header->nodes>size || header->node_bytes>size-header->nodes) {
+    munmap(mapping,size);
+    return NULL;
+  }
+  FlatNnf* nnf      = (FlatNnf*) malloc(sizeof(FlatNnf));
+  nnf->var_count    = header->var_count;
+  nnf->node_count   = header->node_count;
+  nnf->edge_count   = header->edge_count;
+  nnf->added_count  = header->added_count;
+  nnf->types        = (const char*) mapping+header->types;
+  nnf->nodes        = (const BYTE*) mapping+header->nodes;
+  nnf->node_bytes   = header->node_bytes;
+  nnf->mapping      = mapping;
+  nnf->mapping_size = size;
+  if(!valid_flat_nnf(nnf)) {
+    munmap(mapping,size);
+    free(nnf);
+    return NULL;
+  }
+  return nnf;
+}
+
+//returns the flat nnf of fname, a binary or text nnf file, for a cnf with var_count variables,
+//or NULL if the file cannot be read, is malformed or is for another cnf
+FlatNnf* read_flat_nnf(const char* fname, c2dSize var_count) {
+  FILE* file = fopen(fname,"rb");
+  char magic[8];
+  if(file==NULL) return NULL;
+  BOOLEAN binary = fread(magic,sizeof(magic),1,file)==1 && !memcmp(magic,BINARY_NNF_MAGIC,sizeof(magic));
+  fclose(file);
+  return binary? map_flat_nnf(fname,var_count): read_text_flat_nnf(fname,var_count);
+}
+
+void free_flat_nnf(FlatNnf* nnf) {
+  if(nnf->mapping!=NULL) munmap(nnf->mapping,nnf->mapping_size);
+  else {
+    free((char*)nnf->types);
+    free((BYTE*)nnf->nodes);
+  }
+  free(nnf);
+}
+
+static BOOLEAN write_padding(c2dSize from, c2dSize to, FILE* file) {
+  static const char zeros[BINARY_NNF_ALIGNMENT] = {0};
+  return from==to || fwrite(zeros,to-from,1,file)==1;
+}
+
+//saves nnf to the binary nnf file fname
+//returns 0 if the file cannot be written
+BOOLEAN save_binary_flat_nnf(const char* fname, const FlatNnf* nnf) {
+  BinaryNnfHeader header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,BINARY_NNF_MAGIC,sizeof(header.magic));
+  header.byte_order  = BINARY_NNF_BYTE_ORDER;
+  header.var_count   = nnf->var_count;
+  header.node_count  = nnf->node_count;
+  header.edge_count  = nnf->edge_count;
+  header.added_count = nnf->added_count;
+  header.types       = aligned_offset(sizeof(header));
+  header.nodes       = aligned_offset(header.types+nnf->node_count);
+  header.node_bytes  = nnf->node_bytes;
+
+  FILE* file = fopen(fname,"wb");
+  if(file==NULL) return 0;
+  BOOLEAN ok = fwrite(&header,sizeof(header),1,file)==1 &&
+               write_padding(sizeof(header),header.types,file) && fwrite(nnf->types,nnf->node_count,1,file)==1 &&
+               write_padding(header.types+nnf->node_count,header.nodes,file) && fwrite(nnf->nodes,nnf->node_bytes,1,file)==1;
+  return fclose(file)==0 && ok;
+}
+
+//saves nnf to the text nnf file fname (a smoothed Decision-DNNF, as nnf_manager_save_to_file saves them)
+//returns 0 if the file cannot be written
+BOOLEAN save_text_flat_nnf(const char* fname, const FlatNnf* nnf) {
+  FILE* file = fopen(fname,"w");
+  if(file==NULL) return 0;
+  fprintf(file,"nnf %"PRIvS" %"PRIvS" %"PRIvS"\n",nnf->node_count,nnf->edge_count,nnf->var_count);
+  const BYTE* bytes = nnf->nodes;
+  for(c2dSize i=0; i<nnf->node_count; i++) {
+    char type = nnf->types[i];
+    if(type=='L') {
+      fprintf(file,"L %ld\n",unzigzag(read_varint(&bytes)));
+      continue;
+    }
+    if(type=='O') fprintf(file,"O %"PRIvS"",read_varint(&bytes));
+    else fprintf(file,"A");
+    c2dSize size = read_varint(&bytes);
+    fprintf(file," %"PRIvS"",size);
+    for(c2dSize k=0; k<size; k++) fprintf(file," %"PRIvS"",i-read_varint(&bytes));
+    fprintf(file,"\n");
+  }
+  return fclose(file)==0;
+}
+
+/******************************************************************************
+ * evaluation
+ ******************************************************************************/
+
+//sets the count and max-product of each node, given the weight vector of each literal
+//(lane_weights[var_count+l] for literal l). returns the value of the root
+static NodeValue evaluate_flat_nnf(const c2dWmcVector* lane_weights, NodeValue* values, const FlatNnf* nnf) {
+  const BYTE* bytes = nnf->nodes;
+  for(c2dSize i=0; i<nnf->node_count; i++) {
+    NodeValue* value = values+i;
+    char type = nnf->types[i];
+    if(type=='L') {
+      value->count = value->max = lane_weights[nnf->var_count+unzigzag(read_varint(&bytes))];
+      continue;
+    }
+    if(type=='O') read_varint(&bytes); //decision variable
+    c2dSize size = read_varint(&bytes);
+    if(type=='A') {
+      c2dWmcVector count = {0};
+      count += 1;
+      c2dWmcVector max   = count;
+      for(c2dSize k=0; k<size; k++) {
+        const NodeValue* child = value-read_varint(&bytes);
+        count *= child->count;
+        max   *= child->max;
+      }
+      value->count = count;
+      value->max   = max;
+    }
+    else {
+      c2dWmcVector count = {0};
+      c2dWmcVector max   = {0};
+      for(c2dSize k=0; k<size; k++) {
+        const NodeValue* child = value-read_varint(&bytes);
+        count += child->count;
+        vector_max(&max,&child->max);
+      }
+      value->count = count;
+      value->max   = max;
+    }
+  }
+  return values[nnf->node_count-1];
+}
+
+/******************************************************************************
+ * answering queries
+ ******************************************************************************/
+
+typedef struct {
+  c2dLiteral* evidence;
+  c2dSize size;
+  c2dSize capacity;
+} NnfQuery;
+
+//the weights of lanes: a lane has the weights of its weight function, except while a
+//sweep evaluates a query on it, when the literals opposite to the evidence have weight 0
+typedef struct {
+  c2dSize var_count;
+  c2dSize functions;
+  const c2dWmc* weights;        //weights[(var_count+l)*functions+j] is the weight of literal l under function j
+  c2dWmcVector* lane_weights;   //lane_weights[var_count+l] is the weight vector of literal l
+  c2dSize lane_functions[VECTOR_WIDTH]; //weight function of each lane
+} LaneWeights;
+
+//sets the weights of lane to those of weight function j, then to 0 for the literals
+//opposite to the evidence of query
+static void set_lane_weights(int lane, const NnfQuery* query, c2dSize j, LaneWeights* lanes) {
+  c2dSize var_count = lanes->var_count;
+  if(lanes->lane_functions[lane]!=j) {
+    for(c2dSize l=0; l<=2*var_count; l++) lanes->lane_weights[l][lane] = lanes->weights[l*lanes->functions+j];
+    lanes->lane_functions[lane] = j;
+  }
+  for(c2dSize k=0; k<query->size; k++) lanes->lane_weights[var_count-query->evidence[k]][lane] = 0;
+}
+
+static void reset_lane_weights(int lane, const NnfQuery* query, LaneWeights* lanes) {
+  c2dSize var_count = lanes->var_count;
+  for(c2dSize k=0; k<query->size; k++) {
+    c2dSize l = var_count-query->evidence[k];
+    lanes->lane_weights[l][lane] = lanes->weights[l*lanes->functions+lanes->lane_functions[lane]];
+  }
+}
+
+//evaluates each query of queries under each weight function, and prints their counts and max-products
+static void evaluate_queries(const NnfQuery* queries, c2dSize count, c2dSize first, LaneWeights* lanes, NodeValue* values, const FlatNnf* nnf) {
+  c2dSize functions = lanes->functions;
+  c2dSize pairs     = count*functions;
+  c2dWmc* counts    = (c2dWmc*) malloc(2*pairs*sizeof(c2dWmc));
+  c2dWmc* maxes     = counts+pairs;
+  for(c2dSize p=0; p<pairs; p+=VECTOR_WIDTH) {
+    for(int lane=0; lane<VECTOR_WIDTH && p+lane<pairs; lane++) {
+      set_lane_weights(lane,queries+(p+lane)/functions,(p+lane)%functions,lanes);
+    }
+    NodeValue root = evaluate_flat_nnf(lanes->lane_weights,values,nnf);
+    for(int lane=0; lane<VECTOR_WIDTH && p+lane<pairs; lane++) {
+      counts[p+lane] = root.count[lane];
+      maxes[p+lane]  = root.max[lane];
+      reset_lane_weights(lane,queries+(p+lane)/functions,lanes);
+    }
+  }
+  for(c2dSize q=0; q<count; q++) {
+    printf("\n  Query %"PRIvS"",first+q);
+    for(c2dSize j=0; j<functions; j++) {
+      printf(" \t%0.3"PRIwmcS" \t%0.3"PRIwmcS"",counts[q*functions+j],maxes[q*functions+j]);
+    }
+  }
+  fflush(stdout);
+  free(counts);
+}
+
+//prints the (weighted) model count and max-product under the evidence of each query
+//in fname (see evidence.c), under each weight function (weights of the cnf if weights is NULL)
+//queries are evaluated VECTOR_WIDTH lanes at a time, unless read from stdin
+void evaluate_nnf_queries(const char* fname, const FlatNnf* nnf, const LiteralWeights* weights, const SatState* sat_state) {
+  FILE* file = strcmp(fname,"-")? fopen(fname,"r"): stdin;
+  if(file==NULL) {
+    fprintf(stderr,"\nc2D: cannot read evidence queries from %s\n",fname);
+    exit(1);
+  }
+
+  c2dSize var_count = sat_var_count(sat_state);
+  LaneWeights lanes;
+  lanes.var_count = var_count;
+  lanes.functions = weights==NULL? 1: weights->count;
+  c2dWmc* cnf_weights = NULL;
+  if(weights==NULL) {
+    cnf_weights = (c2dWmc*) malloc((2*var_count+1)*sizeof(c2dWmc));
+    for(c2dLiteral l=-(c2dLiteral)var_count; l<=(c2dLiteral)var_count; l++) {
+      cnf_weights[var_count+l] = l? sat_literal_weight(sat_index2literal(l,sat_state)): 1;
+    }
+  }
+  lanes.weights = weights==NULL? cnf_weights: weights->weights;
+  NodeValue* values;
+  if(posix_memalign((void**)&lanes.lane_weights,sizeof(c2dWmcVector),(2*var_count+1)*sizeof(c2dWmcVector)) ||
+     posix_memalign((void**)&values,sizeof(c2dWmcVector),nnf->node_count*sizeof(NodeValue))) {
+    fprintf(stderr,"\nc2D: cannot allocate memory for evaluating the nnf\n");
+    exit(1);
+  }
+  for(int lane=0; lane<VECTOR_WIDTH; lane++) {
+    lanes.lane_functions[lane] = lanes.functions; //none
+    for(c2dSize l=0; l<=2*var_count; l++) lanes.lane_weights[l][lane] = 1;
+  }
+
+  //a batch fills the lanes of a sweep (one lane per query and weight function)
+  NnfQuery batch[VECTOR_WIDTH];
+  memset(batch,0,sizeof(batch));
+  c2dSize batched = 0;
+  c2dSize queries = 0;
+  clock_t start_t = clock();
+  printf("\nQueries (count and max-product per weight function):");
+  while(read_query(file,&batch[batched].evidence,&batch[batched].size,&batch[batched].capacity,var_count)) {
+    ++batched;
+    if(file==stdin || batched*lanes.functions>=VECTOR_WIDTH) {
+      evaluate_queries(batch,batched,queries+1,&lanes,values,nnf);
+      queries += batched;
+      batched  = 0;
+    }
+  }
+  if(batched) evaluate_queries(batch,batched,queries+1,&lanes,values,nnf);
+  queries += batched;
+  double query_t = ((double)(clock()-start_t))/CLOCKS_PER_SEC;
+  printf("\n  Evaluations \t%"PRIvS"",queries*lanes.functions);
+  printf("\n  Query Time\t%0.3fs",query_t);
+  if(query_t>0) printf(" (%0.0f evaluations per second)",queries*lanes.functions/query_t);
+
+  for(int i=0; i<VECTOR_WIDTH; i++) free(batch[i].evidence);
+  free(cnf_weights);
+  free(lanes.lane_weights);
+  free(values);
+  if(file!=stdin) fclose(file);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,363 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+//utilities.c
+void pprint_bytes(const char* string, c2dSize bytes);
+
+extern NNF_NODE ZERO_NNF_NODE;
+extern NNF_NODE ONE_NNF_NODE;
+
+/******************************************************************************
+ * the nnf nodes made while compiling, and their unique table
+ *
+ * the compiler conjoins and disjoins nodes as the nnf manager of libnnf does (see
+ * nnf_conjoin and nnf_disjoin in nnf_api.h), but into the nodes of a UniqueNnf: an
+ * 'A' or 'O' node is made only if the unique table has no node with the same children
+ * (and decision variable). once compiled, the nodes reachable from the root are saved
+ * to an nnf file (in the depth-first order of nnf_manager_save_to_file, see unique_node),
+ * or are made again by an nnf manager (see unique_nnf_manager) whose unique table is
+ * then sized to hold them. hence, the unique table of an nnf manager (which cannot be
+ * resized) is neither allocated for the largest compilation, nor overloaded by larger ones
+ *
+ * the unique table is a flat open-addressing table (linear probing), as the vtree
+ * cache is (see cache.c). it starts small and doubles once the number of nodes
+ * exceeds MAX_LOAD of its capacity. the old slots are then moved a few at a time
+ * (MOVES_PER_INSERT for each node made), so no node waits for the whole table to be
+ * rehashed: until they are all moved, a lookup that misses the new slots also probes
+ * the old ones (which are left as they were, so their probe sequences are intact)
+ *
+ * nodes are allocated in blocks, so they do not move, and are numbered in the order
+ * they are made: children come before their parents
+ ******************************************************************************/
+
+//the table grows when count > MAX_LOAD_NUM/MAX_LOAD_DEN of capacity
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
+#define INITIAL_CAPACITY 1024 //slots of a new table
+#define MOVES_PER_INSERT 16   //old slots moved for each node made (all are moved well before the next resize)
+
+#define NODE_BLOCK_LOG 12     //2^NODE_BLOCK_LOG nodes per block
+
+//multiplier for fibonacci hashing (2^64 divided by the golden ratio)
+#define FIB_HASH 11400714819323198485UL
+
+static inline NnfNode* unique_nnf_node(c2dSize id, const UniqueNnf* nnf) {
+  return nnf->blocks[id>>NODE_BLOCK_LOG]+(id&((1<<NODE_BLOCK_LOG)-1));
+}
+
+static inline HASHCODE node_hashcode(char type, c2dLiteral var, const NnfNode* child1, const NnfNode* child2) {
+  HASHCODE hashcode = type=='O'? (HASHCODE)var: 0;
+  hashcode = hashcode*FIB_HASH + child1->id;
+  hashcode = hashcode*FIB_HASH + child2->id;
+  return hashcode;
+}
+
+static inline c2dSize home_slot(HASHCODE hashcode, int shift) {
+  return (c2dSize)((hashcode*FIB_HASH)>>shift);
+}
+
+/******************************************************************************
+ * constructing and freeing
+ ******************************************************************************/
+
+static NnfNode* new_node(char type, c2dLiteral literal, NnfNode* child1, NnfNode* child2, UniqueNnf* nnf) {
+  c2dSize id = nnf->node_count++;
+  c2dSize block = id>>NODE_BLOCK_LOG;
+  if(block==nnf->block_capacity) {
+    nnf->block_capacity *= 2;
+    nnf->blocks = (NnfNode**) realloc(nnf->blocks,nnf->block_capacity*sizeof(NnfNode*));
+  }
+  if((id&((1<<NODE_BLOCK_LOG)-1))==0) nnf->blocks[block] = (NnfNode*) malloc(sizeof(NnfNode)<<NODE_BLOCK_LOG);
+  NnfNode* node     = unique_nnf_node(id,nnf);
+  node->id          = id;
+  node->type        = type;
+  node->literal     = literal;
+  node->children[0] = child1;
+  node->children[1] = child2;
+  return node;
+}
+
+static void allocate_slots(c2dSize capacity, UniqueNnf* nnf) {
+  int log = 0;
+  while(((c2dSize)1<<log) < capacity) ++log;
+  nnf->capacity = (c2dSize)1<<log;
+  nnf->shift    = 8*sizeof(HASHCODE)-log;
+  nnf->slots    = (NnfUniqueSlot*) calloc(nnf->capacity,sizeof(NnfUniqueSlot));
+}
+
+//returns an empty UniqueNnf with a node for each literal of the cnf of sat_state
+UniqueNnf* new_unique_nnf(const SatState* sat_state) {
+  UniqueNnf* nnf      = (UniqueNnf*) calloc(1,sizeof(UniqueNnf));
+  nnf->var_count      = sat_var_count(sat_state);
+  nnf->block_capacity = 16;
+  nnf->blocks         = (NnfNode**) malloc(nnf->block_capacity*sizeof(NnfNode*));
+  nnf->zero           = new_node('0',0,NULL,NULL,nnf);
+  nnf->one            = new_node('1',0,NULL,NULL,nnf);
+  nnf->literals       = (NnfNode**) calloc(2*nnf->var_count+1,sizeof(NnfNode*));
+  for(c2dLiteral l=1; l<=(c2dLiteral)nnf->var_count; l++) {
+    nnf->literals[nnf->var_count+l] = new_node('L',l,NULL,NULL,nnf);
+    nnf->literals[nnf->var_count-l] = new_node('L',-l,NULL,NULL,nnf);
+  }
+  allocate_slots(INITIAL_CAPACITY,nnf);
+  return nnf;
+}
+
+void free_unique_nnf(UniqueNnf* nnf) {
+  for(c2dSize b=0; b<<NODE_BLOCK_LOG < nnf->node_count; b++) free(nnf->blocks[b]);
+  free(nnf->blocks);
+  free(nnf->literals);
+  free(nnf->slots);
+  free(nnf->old_slots);
+  free(nnf);
+}
+
+/******************************************************************************
+ * unique table
+ ******************************************************************************/
+
+static void move_old_slots(c2dSize moves, UniqueNnf* nnf) {
+  c2dSize mask = nnf->capacity-1;
+  for(; moves>0 && nnf->moved<nnf->old_capacity; moves--) {
+    NnfUniqueSlot* old = nnf->old_slots+nnf->moved++;
+    if(old->node==NULL) continue;
+    c2dSize i = home_slot(old->hashcode,nnf->shift);
+    while(nnf->slots[i].node!=NULL) i = (i+1)&mask;
+    nnf->slots[i] = *old;
+  }
+  if(nnf->moved==nnf->old_capacity) {
+    free(nnf->old_slots);
+    nnf->old_slots = NULL;
+  }
+}
+
+//double the number of slots (the old slots are moved by later inserts)
+static void grow_unique_table(UniqueNnf* nnf) {
+  if(nnf->old_slots!=NULL) move_old_slots(nnf->old_capacity,nnf); //finish the last resize
+  nnf->old_slots    = nnf->slots;
+  nnf->old_capacity = nnf->capacity;
+  nnf->old_shift    = nnf->shift;
+  nnf->moved        = 0;
+  allocate_slots(2*nnf->old_capacity,nnf);
+  ++nnf->resizes;
+}
+
+static inline BOOLEAN same_node(const NnfNode* node, char type, c2dLiteral var, const NnfNode* child1, const NnfNode* child2) {
+  return node->type==type && node->literal==var && node->children[0]==child1 && node->children[1]==child2;
+}
+
+static NnfNode* lookup_slots(const NnfUniqueSlot* slots, c2dSize capacity, int shift, HASHCODE hashcode,
+                             char type, c2dLiteral var, const NnfNode* child1, const NnfNode* child2) {
+  c2dSize mask = capacity-1;
+  for(c2dSize i=home_slot(hashcode,shift); slots[i].node!=NULL; i=(i+1)&mask) {
+    if(slots[i].hashcode==hashcode && same_node(slots[i].node,type,var,child1,child2)) return slots[i].node;
+  }
+  return NULL;
+}
+
+//returns the unique 'A' or 'O' node with these children (ordered by id), making it if needed
+//
+//libnnf orders the children of an 'A' node by id too, but those of an 'O' node by address,
+//which follows the order nodes are made except across its memory blocks. hence, an nnf file
+//has the same node and edge counts as one saved by libnnf, but the two children of a few
+//'O' nodes may be listed in the other order (and so may the nodes first reached from them)
+static NnfNode* unique_node(char type, c2dLiteral var, NnfNode* child1, NnfNode* child2, UniqueNnf* nnf) {
+  if(child1->id > child2->id) {
+    NnfNode* child = child1;
+    child1 = child2;
+    child2 = child;
+  }
+  HASHCODE hashcode = node_hashcode(type,var,child1,child2);
+  ++nnf->lookups;
+  NnfNode* node = lookup_slots(nnf->slots,nnf->capacity,nnf->shift,hashcode,type,var,child1,child2);
+  if(node==NULL && nnf->old_slots!=NULL) {
+    node = lookup_slots(nnf->old_slots,nnf->old_capacity,nnf->old_shift,hashcode,type,var,child1,child2);
+  }
+  if(node!=NULL) {
+    ++nnf->hits;
+    return node;
+  }
+
+  if(MAX_LOAD_DEN*(nnf->count+1) > MAX_LOAD_NUM*nnf->capacity) grow_unique_table(nnf);
+  if(nnf->old_slots!=NULL) move_old_slots(MOVES_PER_INSERT,nnf);
+  node = new_node(type,var,child1,child2,nnf);
+  c2dSize mask = nnf->capacity-1;
+  c2dSize i = home_slot(hashcode,nnf->shift);
+  while(nnf->slots[i].node!=NULL) i = (i+1)&mask;
+  nnf->slots[i].hashcode = hashcode;
+  nnf->slots[i].node     = node;
+  ++nnf->count;
+  return node;
+}
+
+/******************************************************************************
+ * nodes (as nnf_literal2node, nnf_conjoin and nnf_disjoin in nnf_api.h)
+ ******************************************************************************/
+
+NnfNode* unique_literal(const Lit* lit, const UniqueNnf* nnf) {
+  return nnf->literals[nnf->var_count+sat_literal_index(lit)];
+}
+
+NnfNode* unique_conjoin(NnfNode* node1, NnfNode* node2, UniqueNnf* nnf) {
+  if(node1==nnf->zero || node2==nnf->zero) return nnf->zero;
+  if(node1==nnf->one) return node2;
+  if(node2==nnf->one) return node1;
+  return unique_node('A',0,node1,node2,nnf);
+}
+
+//node1 and node2 are x.f and ~x.g for a literal x of var (see nnf_disjoin in nnf_api.h)
+NnfNode* unique_disjoin(const Var* var, NnfNode* node1, NnfNode* node2, UniqueNnf* nnf) {
+  if(node1==nnf->one || node2==nnf->one) return nnf->one;
+  if(node1==nnf->zero) return node2;
+  if(node2==nnf->zero) return node1;
+  if(node1->type=='L' && node2->type=='L' && node1->literal==-node2->literal) return nnf->one;
+  return unique_node('O',sat_var_index(var),node1,node2,nnf);
+}
+
+/******************************************************************************
+ * saving the nodes reachable from a root
+ ******************************************************************************/
+
+//returns the positions of the nodes reachable from root (1+their position in a depth-first
+//post-order, 0 if unreachable), sets order to the nodes in that order (children before
+//parents, as nnf_manager_save_to_file writes them), and sets their count and edge count
+#define ON_STACK ((c2dSize)-1)
+static c2dSize* reachable_positions(const NnfNode* root, const NnfNode*** order, c2dSize* node_count, c2dSize* edge_count) {
+  c2dSize* positions    = (c2dSize*) calloc(root->id+1,sizeof(c2dSize));
+  const NnfNode** stack = (const NnfNode**) malloc((root->id+1)*sizeof(const NnfNode*));
+  int* next_child       = (int*) malloc((root->id+1)*sizeof(int));
+  *order      = (const NnfNode**) malloc((root->id+1)*sizeof(const NnfNode*));
+  *node_count = *edge_count = 0;
+
+  c2dSize top = 0;
+  stack[0] = root; next_child[0] = 0;
+  positions[root->id] = ON_STACK; //on the stack
+  for(;;) {
+    const NnfNode* node = stack[top];
+    if(node->children[0]!=NULL && next_child[top]<2) {
+      const NnfNode* child = node->children[next_child[top]++];
+      if(positions[child->id]==0) {
+        positions[child->id] = ON_STACK;
+        stack[++top] = child; next_child[top] = 0;
+      }
+      continue;
+    }
+    (*order)[*node_count] = node;
+    positions[node->id]   = ++*node_count;
+    if(node->children[0]!=NULL) *edge_count += 2;
+    if(top==0) break;
+    --top;
+  }
+  free(stack);
+  free(next_child);
+  return positions;
+}
+
+//saves the nnf rooted at root to the nnf file fname, and returns its node and edge count
+//(as nnf_manager_save_to_file does)
+void save_unique_nnf(const char* fname, const NnfNode* root, const UniqueNnf* nnf, c2dSize* node_count, c2dSize* edge_count) {
+  const NnfNode** order;
+  c2dSize* positions = reachable_positions(root,&order,node_count,edge_count);
+  FILE* file = fopen(fname,"w");
+  if(file==NULL) {
+    fprintf(stderr,"\nc2D: cannot write nnf file %s\n",fname);
+    exit(1);
+  }
+  fprintf(file,"nnf %"PRIvS" %"PRIvS" %"PRIvS"\n",*node_count,*edge_count,nnf->var_count);
+  for(c2dSize i=0; i<*node_count; i++) { //children before parents
+    const NnfNode* node = order[i];
+    switch(node->type) {
+      case '0': fprintf(file,"O 0 0\n"); break;
+      case '1': fprintf(file,"A 0\n"); break;
+      case 'L': fprintf(file,"L %ld\n",node->literal); break;
+      case 'A': fprintf(file,"A 2 %"PRIvS" %"PRIvS"\n",positions[node->children[0]->id]-1,positions[node->children[1]->id]-1); break;
+      default:  fprintf(file,"O %ld 2 %"PRIvS" %"PRIvS"\n",node->literal,positions[node->children[0]->id]-1,positions[node->children[1]->id]-1);
+    }
+  }
+  fclose(file);
+  free(positions);
+  free(order);
+}
+
+//returns an nnf manager whose root is (a copy of) root, made of the nodes reachable from it
+NnfManager* unique_nnf_manager(const NnfNode* root, const UniqueNnf* nnf, const SatState* sat_state) {
+  c2dSize node_count, edge_count;
+  const NnfNode** order;
+  c2dSize* positions = reachable_positions(root,&order,&node_count,&edge_count);
+  NNF_NODE* copies   = (NNF_NODE*) malloc((node_count+1)*sizeof(NNF_NODE));
+
+  //the unique table of the manager holds the 'A' and 'O' nodes (which have two edges each)
+  NnfManager* manager = nnf_manager_new(sat_state,(edge_count/2)|1);
+  for(c2dSize i=0; i<node_count; i++) { //children before parents
+    const NnfNode* node = order[i];
+    NNF_NODE* copy = copies+i+1;
+    if(node->type=='0')      *copy = ZERO_NNF_NODE;
+    else if(node->type=='1') *copy = ONE_NNF_NODE;
+    else if(node->type=='L') *copy = nnf_literal2node(sat_index2literal(node->literal,sat_state),manager);
+    else {
+      NNF_NODE child1 = copies[positions[node->children[0]->id]];
+      NNF_NODE child2 = copies[positions[node->children[1]->id]];
+      if(node->type=='A') *copy = nnf_conjoin(child1,child2,manager);
+      else *copy = nnf_disjoin(sat_index2var(node->literal,sat_state),child1,child2,manager);
+    }
+  }
+  nnf_manager_set_root(copies[node_count],manager);
+  free(positions);
+  free(order);
+  free(copies);
+  return manager;
+}
+
+/******************************************************************************
+ * stats
+ ******************************************************************************/
+
+//returns the memory used by the nodes and the unique table as a number of bytes
+c2dSize unique_nnf_memory(const UniqueNnf* nnf) {
+  c2dSize blocks = (nnf->node_count+(1<<NODE_BLOCK_LOG)-1)>>NODE_BLOCK_LOG;
+  c2dSize slots  = nnf->capacity+(nnf->old_slots!=NULL? nnf->old_capacity: 0);
+  return blocks*(sizeof(NnfNode)<<NODE_BLOCK_LOG) + slots*sizeof(NnfUniqueSlot);
+}
+
+//probe lengths (distance of nodes from their home slots), counting only the
+//old slots that have not been moved yet
+static void probe_stats(const UniqueNnf* nnf, c2dSize* max, double* ave) {
+  *max = 0;
+  *ave = 0;
+  for(c2dSize i=0; i<nnf->capacity; i++) {
+    if(nnf->slots[i].node==NULL) continue;
+    c2dSize probe = 1+((i-home_slot(nnf->slots[i].hashcode,nnf->shift))&(nnf->capacity-1));
+    *ave += probe;
+    if(probe > *max) *max = probe;
+  }
+  for(c2dSize i=nnf->moved; nnf->old_slots!=NULL && i<nnf->old_capacity; i++) {
+    if(nnf->old_slots[i].node==NULL) continue;
+    c2dSize probe = 1+((i-home_slot(nnf->old_slots[i].hashcode,nnf->old_shift))&(nnf->old_capacity-1));
+    *ave += probe;
+    if(probe > *max) *max = probe;
+  }
+  if(nnf->count) *ave = *ave/nnf->count;
+}
+
+void print_unique_nnf_stats(const UniqueNnf* nnf) {
+  c2dSize max_probe;
+  double ave_probe;
+  probe_stats(nnf,&max_probe,&ave_probe);
+
+  printf("\nUnique table stats:");
+  printf(     "\n  nodes      \t%"PRIvS" (%"PRIvS" in table)",nnf->node_count,nnf->count);
+  printf(     "\n  hit rate   \t%.1f%%",nnf->lookups? (100.0*nnf->hits)/nnf->lookups: 0.0);
+  printf(     "\n  lookups    \t%"PRIvS"",nnf->lookups);
+  pprint_bytes("\n  memory     \t",unique_nnf_memory(nnf));
+  printf(     "\n  load       \t%.2f (%"PRIvS" slots, %"PRIvS" resizes)",(double)nnf->count/nnf->capacity,nnf->capacity,nnf->resizes);
+  printf(     "\n  probes     \t%0.1f ave, %"PRIvS" max",ave_probe,max_probe);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,193 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _DEFAULT_SOURCE //fork, mmap and clock_gettime
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "c2d.h"
+
+/******************************************************************************
+ * splitting the top of a vtree into tasks, and running them in parallel jobs
+ *
+ * the top of the vtree is unfolded into a tree of tasks: a task counts (or compiles)
+ * a vtree node under a cube (see VtreeTask in c2d.h). a task is split at a decomposition
+ * node into one task per child (same cube), whose results are conjoined, and at a
+ * Shannon node into one task per literal of its variable (cube extended by that
+ * literal), whose results are combined by case analysis on the variable. tasks are
+ * split (see better_split) until there are TASKS_PER_JOB tasks per job, but Shannon
+ * nodes only until there is one task per job: the two tasks of a Shannon node solve
+ * the sub-problems they have in common twice (unless counts share them, see option -S),
+ * so each Shannon split adds work. on 2bitcomp_5 (-m 2), whose vtree has Shannon nodes
+ * at its top, 4 jobs (-j 4) do about 4.8x the work of one, and 1.6x with option -S
+ *
+ * the remaining (unsplit) tasks are run by jobs forked from this process, so each
+ * job has its own copy of the sat state, learned clauses and vtree cache. jobs take
+ * the next task from a counter in shared memory, so a job that finishes early takes
+ * over tasks that would otherwise wait for a busy one
+ *
+ * the sat state and vtree keep mutable per-node state (vtree keys, marks, decisions)
+ * that cannot be shared between threads, hence jobs are processes rather than threads
+ ******************************************************************************/
+
+#define TASKS_PER_JOB 4
+
+//stats of the last parallel run
+static c2dSize task_count, job_count;
+static double wall_time, jobs_time;
+static struct timespec start_time;
+
+/******************************************************************************
+ * splitting tasks
+ ******************************************************************************/
+
+static c2dSize new_task(DVtree* vtree, const c2dLiteral* cube, c2dSize size, c2dLiteral literal, VtreeTask* tasks, c2dSize* count) {
+  VtreeTask* task = tasks+*count;
+  task->vtree = vtree;
+  task->size  = size+(literal!=0);
+  task->cube  = (c2dLiteral*) malloc((task->size+1)*sizeof(c2dLiteral));
+  if(size) memcpy(task->cube,cube,size*sizeof(c2dLiteral));
+  if(literal!=0) task->cube[size] = literal;
+  task->left  = 0;
+  task->right = 0;
+  return (*count)++;
+}
+
+//splitting a decomposition node costs nothing, while the two tasks of a Shannon node
+//cannot share the results of the sub-problems they have in common (they are run by
+//different jobs): prefer decomposition nodes, then nodes with more variables
+static inline BOOLEAN better_split(const DVtree* vtree, const DVtree* best) {
+  BOOLEAN shannon = vtree_is_shannon_node(vtree);
+  if(shannon!=vtree_is_shannon_node(best)) return !shannon;
+  return vtree->var_count > best->var_count;
+}
+
+//returns the tasks of root for jobs (subtasks come after their task), and sets their count
+//(no unsplit task is split further once there are TASKS_PER_JOB*jobs unsplit tasks, and
+//no Shannon node once there are jobs unsplit tasks)
+VtreeTask* split_vtree_tasks(DVtree* root, c2dSize jobs, c2dSize* count) {
+  clock_gettime(CLOCK_MONOTONIC,&start_time);
+
+  c2dSize limit   = jobs*TASKS_PER_JOB;
+  VtreeTask* tasks = (VtreeTask*) malloc((2*limit+1)*sizeof(VtreeTask));
+  *count = 0;
+  new_task(root,NULL,0,0,tasks,count);
+  for(c2dSize unsplit=1; unsplit<limit; unsplit++) {
+    VtreeTask* best = NULL;
+    for(c2dSize i=0; i<*count; i++) {
+      VtreeTask* task = tasks+i;
+      if(task->left!=0 || vtree_is_leaf(task->vtree)) continue;
+      if(best==NULL || better_split(task->vtree,best->vtree)) best = task;
+    }
+    if(best==NULL) break;
+    DVtree* vtree = best->vtree;
+    if(vtree_is_shannon_node(vtree) && unsplit>=jobs) break; //no decomposition node is left
+    if(vtree_is_shannon_node(vtree)) {
+      c2dLiteral var = sat_var_index(vtree_shannon_var(vtree));
+      best->left  = new_task(vtree->right,best->cube,best->size,var,tasks,count);
+      best->right = new_task(vtree->right,best->cube,best->size,-var,tasks,count);
+    }
+    else {
+      best->left  = new_task(vtree->left,best->cube,best->size,0,tasks,count);
+      best->right = new_task(vtree->right,best->cube,best->size,0,tasks,count);
+    }
+  }
+  return tasks;
+}
+
+void free_vtree_tasks(VtreeTask* tasks, c2dSize count) {
+  for(c2dSize i=0; i<count; i++) free(tasks[i].cube);
+  free(tasks);
+}
+
+/******************************************************************************
+ * running tasks
+ ******************************************************************************/
+
+//returns memory shared by this process and the jobs it forks
+void* new_shared_memory(c2dSize bytes) {
+  void* memory = mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+  if(memory==MAP_FAILED) {
+    fprintf(stderr,"\nc2D: cannot allocate memory shared by jobs\n");
+    exit(1);
+  }
+  return memory;
+}
+
+void free_shared_memory(void* memory, c2dSize bytes) {
+  munmap(memory,bytes);
+}
+
+static double seconds_since(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return (now.tv_sec-start->tv_sec) + 1e-9*(now.tv_nsec-start->tv_nsec);
+}
+
+//run each unsplit task (given by its index) by one of jobs processes (given by its index), and wait for them
+//run_task is called in the jobs, so it must leave its results in shared memory (or files)
+void run_vtree_tasks(const VtreeTask* tasks, c2dSize count, c2dSize jobs, void (*run_task)(c2dSize index, c2dSize job, void* data), void* data) {
+  c2dSize* next = (c2dSize*) new_shared_memory(sizeof(c2dSize));
+  *next = 0;
+
+  fflush(stdout); //otherwise, buffered output is repeated by each job
+  for(c2dSize j=0; j<jobs; j++) {
+    pid_t pid = fork();
+    if(pid<0) {
+      fprintf(stderr,"\nc2D: cannot start job\n");
+      exit(1);
+    }
+    if(pid==0) { //job
+      c2dSize i;
+      while((i=__atomic_fetch_add(next,1,__ATOMIC_RELAXED)) < count) {
+        if(tasks[i].left==0) run_task(i,j,data); //otherwise, task is split
+      }
+      _exit(0);
+    }
+  }
+  BOOLEAN failed = 0;
+  int status;
+  while(wait(&status)>0) {
+    if(!WIFEXITED(status) || WEXITSTATUS(status)!=0) failed = 1;
+  }
+  if(failed) {
+    fprintf(stderr,"\nc2D: job failed\n");
+    exit(1);
+  }
+  free_shared_memory(next,sizeof(c2dSize));
+
+  struct rusage usage;
+  getrusage(RUSAGE_CHILDREN,&usage);
+  task_count = count;
+  job_count  = jobs;
+  wall_time  = seconds_since(&start_time);
+  jobs_time  = usage.ru_utime.tv_sec+usage.ru_stime.tv_sec + 1e-6*(usage.ru_utime.tv_usec+usage.ru_stime.tv_usec);
+}
+
+/******************************************************************************
+ * stats
+ ******************************************************************************/
+
+//returns the wall time since the last parallel run started splitting its tasks (the time 
+//of the run, including the work of the parent on its results, when called once it is done)
+double parallel_run_time() {
+  return seconds_since(&start_time);
+}
+
+void print_parallel_stats() {
+  c2dSize unsplit = (task_count+1)/2; //each split adds two tasks
+  printf("\nParallel stats:");
+  printf(     "\n  jobs       \t%"PRIvS"",job_count);
+  printf(     "\n  tasks      \t%"PRIvS" run (%"PRIvS" split)",unsplit,task_count-unsplit);
+  printf(     "\n  wall time  \t%0.3fs",wall_time);
+  printf(     "\n  jobs time  \t%0.3fs",jobs_time);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
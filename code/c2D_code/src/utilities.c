@@ -4,6 +4,7 @@
  * http://reasoning.cs.ucla.edu/c2d
  ******************************************************************************/
 
+#include <math.h>
 #include "c2d.h"
 
 /******************************************************************************
@@ -21,6 +22,15 @@ void pprint_bytes(const char* string, c2dSize bytes) {
   else printf("%s%0.1f GB",string,(double)bytes/GB);
 }
 
+//prints a count given its base-10 logarithm (-infinity for 0) in scientific notation
+void pprint_log10_count(const char* string, long double log10_count) {
+  if(log10_count==-INFINITY) { printf("%s0",string); return; }
+  long double exponent = floorl(log10_count);
+  long double mantissa = powl(10,log10_count-exponent);
+  if(mantissa>=9.9995L) { mantissa /= 10; exponent += 1; } //would be rounded to 10.000
+  printf("%s%0.3Lfe%+.0Lf",string,mantissa,exponent);
+}
+
 //augments fname with new_extension
 char* extended_file_name(const char* fname, const char* new_extension) {
   unsigned size = strlen(fname); //size of fname excluding . and extension
@@ -39,6 +49,32 @@ const char* vtree_type(const c2dOptions* options) {
   else return "incidence graph";
 }
 
+//a fingerprint of the clauses and literal weights of the cnf (to check that a shared
+//component table or a cache file was filled by counting the same cnf)
+HASHCODE cnf_fingerprint(const SatState* sat_state) {
+  HASHCODE hashcode = sat_var_count(sat_state);
+  for(c2dSize i=1; i<=sat_var_count(sat_state); i++) {
+    Var* var = sat_index2var(i,sat_state);
+    c2dWmc weights[2] = { sat_literal_weight(sat_pos_literal(var)), sat_literal_weight(sat_neg_literal(var)) };
+    for(int j=0; j<2; j++) {
+      HASHCODE bits;
+      memcpy(&bits,weights+j,sizeof(bits));
+      hashcode = (hashcode^bits)*0x9E3779B97F4A7C15UL;
+      hashcode ^= hashcode>>32;
+    }
+  }
+  for(c2dSize i=1; i<=sat_clause_count(sat_state); i++) {
+    Clause* clause = sat_index2clause(i,sat_state);
+    Lit** literals = sat_clause_literals(clause);
+    for(c2dSize k=0; k<sat_clause_size(clause); k++) {
+      hashcode = (hashcode^(HASHCODE)sat_literal_index(literals[k]))*0x9E3779B97F4A7C15UL;
+      hashcode ^= hashcode>>32;
+    }
+    hashcode = (hashcode^0)*0x9E3779B97F4A7C15UL; //end of clause
+  }
+  return hashcode;
+}
+
 /******************************************************************************
  * end
  ******************************************************************************/
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+//local
+void free_literal_weights(LiteralWeights* weights);
+
+/******************************************************************************
+ * reading literal weights from a file
+ *
+ * a weights file has the following form, where K is the number of weight functions:
+ *   c comment
+ *   p weights K
+ *   l w_1 ... w_K
+ *   ...
+ * with one line per literal l (a nonzero integer, as in dimacs), giving its weight
+ * under each weight function. literals that have no line have weight 1 under all 
+ * functions
+ ******************************************************************************/
+
+//skip the rest of the current line
+static void skip_line(FILE* file) {
+  int c;
+  while((c=fgetc(file))!=EOF && c!='\n');
+}
+
+//returns literal weights for the variables of sat_state, or NULL if the file cannot be read
+LiteralWeights* read_literal_weights(const char* fname, const SatState* sat_state) {
+  FILE* file = fopen(fname,"r");
+  if(file==NULL) return NULL;
+
+  //header
+  long count = 0;
+  int c;
+  while((c=fgetc(file))=='c') skip_line(file);
+  if(c!='p' || fscanf(file," weights %ld",&count)!=1 || count<1) {
+    fclose(file);
+    return NULL;
+  }
+
+  LiteralWeights* weights = (LiteralWeights*) malloc(sizeof(LiteralWeights));
+  weights->var_count = sat_var_count(sat_state);
+  weights->count     = count;
+  c2dSize size       = (2*weights->var_count+1)*weights->count;
+  weights->weights   = (c2dWmc*) malloc(size*sizeof(c2dWmc));
+  for(c2dSize i=0; i<size; i++) weights->weights[i] = 1;
+
+  //one line per literal
+  long literal;
+  while(fscanf(file," %ld",&literal)==1) {
+    if(literal==0 || labs(literal)>(long)weights->var_count) break;
+    c2dWmc* row = weights->weights+(weights->var_count+literal)*weights->count;
+    c2dSize j = 0;
+    while(j<weights->count && fscanf(file," %lf",row+j)==1) ++j;
+    if(j<weights->count) break;
+  }
+  BOOLEAN complete = feof(file);
+  fclose(file);
+
+  if(!complete) { //malformed line
+    free_literal_weights(weights);
+    return NULL;
+  }
+  return weights;
+}
+
+void free_literal_weights(LiteralWeights* weights) {
+  free(weights->weights);
+  free(weights);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -115,6 +115,7 @@ struct Clause {
     
     BOOLEAN was_generated;
     c2dSize assertion_level;
+    c2dSize lbd;            // number of decision levels of its literals when it was learned
     
     c2dSize index;
     Lit **elements;
@@ -127,6 +128,30 @@ struct Clause {
     
 };
 
+/******************************************************************************
+ * Observers:
+ * --Functions that are notified when the state of a clause or literal changes
+ * --A clause observer is called whenever a clause becomes subsumed or stops
+ * being subsumed
+ * --A literal observer is called whenever a literal becomes implied or stops
+ * being implied (the literal passed is the one that is/was implied)
+ ******************************************************************************/
+
+typedef void (*SatClauseObserver)(const Clause* clause, void* data);
+typedef void (*SatLiteralObserver)(const Lit* lit, void* data);
+
+/******************************************************************************
+ * Packed state:
+ * --The subsumed flags of clauses and the implied flags of literals are also
+ * kept in bitsets of words with SAT_WORD_BITS bits each (bit i is bit i%SAT_WORD_BITS
+ * of word i/SAT_WORD_BITS)
+ * --Bit i of the clause bitset is set iff the clause with index i is subsumed
+ * --Bits 2i and 2i+1 of the literal bitset are set iff the positive and negative
+ * literals of the variable with index i are implied
+ ******************************************************************************/
+
+#define SAT_WORD_BITS (8*sizeof(unsigned long))
+
 /******************************************************************************
  * SatState:
  * --The following structure will keep track of the data needed to
@@ -155,6 +180,13 @@ typedef struct sat_state_t {
     Clause *assertion_clause;
     c2dSize assertion_clause_count;
     
+    SatClauseObserver  clause_observer;
+    SatLiteralObserver literal_observer;
+    void              *observer_data;
+    
+    unsigned long *subsumed_bits; // room for clauses_capacity clauses
+    unsigned long *implied_bits;
+    
 } SatState;
 
 /******************************************************************************
@@ -262,6 +294,21 @@ c2dSize sat_learned_clause_count(const SatState* sat_state);
 //moreover, it should be called only if sat_at_assertion_level() succeeds
 Clause* sat_assert_clause(Clause* clause, SatState* sat_state);
 
+//adds a clause, given by the indices of its literals, to the set of learned clauses
+//the clause must be implied by the cnf, and no literal may be decided
+void sat_add_learned_clause(const c2dLiteral* literals, c2dSize size, SatState* sat_state);
+
+//saves the learned clauses of sat state with at most max_size literals and a literal block
+//distance (the number of decision levels of its literals when it was learned) of at most
+//max_lbd to a file (0 for no limit), and sets their count
+//returns 0 if the file cannot be written
+BOOLEAN sat_save_learned_clauses(const char* fname, c2dSize max_size, c2dSize max_lbd, c2dSize* count, const SatState* sat_state);
+
+//adds the learned clauses saved in a file by sat_save_learned_clauses() to sat state, and sets
+//their count (0 if the file does not exist). no literal may be decided
+//returns 0 if the file was saved for another cnf (it is then ignored)
+BOOLEAN sat_load_learned_clauses(const char* fname, c2dSize* count, SatState* sat_state);
+
 /******************************************************************************
  * SatState
  ******************************************************************************/
@@ -287,6 +334,18 @@ void sat_undo_unit_resolution(SatState* sat_state);
 //it is used to decide whether the sat state is at the right decision level for adding clause.
 BOOLEAN sat_at_assertion_level(const Clause* clause, const SatState* sat_state);
 
+//sets the observers of a sat state (either can be NULL), which are passed data when called
+void sat_set_observers(SatClauseObserver clause_observer, SatLiteralObserver literal_observer, void* data, SatState* sat_state);
+
+//returns the data passed to the observers of a sat state
+void* sat_observer_data(const SatState* sat_state);
+
+//returns the packed subsumed flags of clauses (see SAT_WORD_BITS)
+const unsigned long* sat_subsumed_bits(const SatState* sat_state);
+
+//returns the packed implied flags of literals (see SAT_WORD_BITS)
+const unsigned long* sat_implied_bits(const SatState* sat_state);
+
 /******************************************************************************
  * The functions below are already implemented for you and MUST STAY AS IS
  ******************************************************************************/
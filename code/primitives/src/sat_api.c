@@ -181,6 +181,34 @@ BOOLEAN resolved_literal(const Lit* lit) {
     return 0;
 }
 
+//flip bit i of a packed bitset
+static inline void flip_bit(unsigned long *bits, c2dSize i) {
+    bits[ i / SAT_WORD_BITS ] ^= 1UL << ( i % SAT_WORD_BITS );
+}
+
+//set the subsumed flag of a clause, notifying the observer if the flag changes
+static inline void set_subsumed(Clause* clause, BOOLEAN subsumed, SatState* sat_state) {
+    if( clause->is_subsumed == subsumed )
+        return;
+    clause->is_subsumed = subsumed;
+    flip_bit(sat_state->subsumed_bits, clause->index);
+    if( sat_state->clause_observer != NULL )
+        sat_state->clause_observer(clause, sat_state->observer_data);
+}
+
+//the variable of lit was just set or unset (and lit is/was the implied literal):
+//update the implied bits, then notify the observer
+static inline void notify_literal(const Lit* lit, SatState* sat_state) {
+    flip_bit(sat_state->implied_bits, 2 * lit->var_ptr->index + ( lit->var_ptr->set_sign == 0 ));
+    if( sat_state->literal_observer != NULL )
+        sat_state->literal_observer(lit, sat_state->observer_data);
+}
+
+//allocate a zeroed bitset with room for bits 0..n
+static unsigned long* new_bitset(c2dSize n) {
+    return (unsigned long*) calloc( n / SAT_WORD_BITS + 1, sizeof(unsigned long) );
+}
+
 //calculate the maximum level in the clause
 unsigned long calc_decision_level(const Clause *clause) {
     unsigned long decision_level = 1;
@@ -220,6 +248,7 @@ c2dSize apply_literal(Lit* lit, Clause* clause, SatState* sat_state) {
     var->decision_level =
         ( clause != NULL ) ? calc_decision_level(clause) : ( sat_state->decisions_size + 2 );
     lit->var_ptr->is_set = 1;
+    notify_literal(lit, sat_state);
     
     // flag all the clauses that use this new setting
     unsigned long index;
@@ -227,7 +256,7 @@ c2dSize apply_literal(Lit* lit, Clause* clause, SatState* sat_state) {
         if( var->pos_literal->used_clauses[index]->is_subsumed )
             continue;
         if( var->set_sign == 1 )
-            var->pos_literal->used_clauses[index]->is_subsumed = 1;
+            set_subsumed(var->pos_literal->used_clauses[index], 1, sat_state);
         else
             mark_check_clause(var->pos_literal->used_clauses[index], sat_state);
     }
@@ -235,7 +264,7 @@ c2dSize apply_literal(Lit* lit, Clause* clause, SatState* sat_state) {
         if( var->neg_literal->used_clauses[index]->is_subsumed )
             continue;
         if( var->set_sign == 0 )
-            var->neg_literal->used_clauses[index]->is_subsumed = 1;
+            set_subsumed(var->neg_literal->used_clauses[index], 1, sat_state);
         else
             mark_check_clause(var->neg_literal->used_clauses[index], sat_state);
     }
@@ -249,16 +278,19 @@ BOOLEAN unapply_literal(Lit *lit, SatState* sat_state) {
         return 0;
     
     unsigned long index, vi;
+    BOOLEAN subsumed;
     Var *var = lit->var_ptr;
     var->is_set = 0;
+    notify_literal(lit, sat_state);
     
     if( var->set_sign == 1 ) {
         for( index = 0; index < var->pos_literal->used_clauses_size; ++index ) {
             if( var->pos_literal->used_clauses[index]->is_subsumed ) {
-                var->pos_literal->used_clauses[index]->is_subsumed = 0;
+                subsumed = 0;
                 for( vi = 0; vi < var->pos_literal->used_clauses[index]->elements_size; ++vi )
                     if( asserted_literal(var->pos_literal->used_clauses[index]->elements[vi]) )
-                        var->pos_literal->used_clauses[index]->is_subsumed = 1;
+                        subsumed = 1;
+                set_subsumed(var->pos_literal->used_clauses[index], subsumed, sat_state);
                 mark_check_clause(var->pos_literal->used_clauses[index], sat_state);
             }
         }
@@ -266,10 +298,11 @@ BOOLEAN unapply_literal(Lit *lit, SatState* sat_state) {
     else {
         for( index = 0; index < var->neg_literal->used_clauses_size; ++index ) {
             if( var->neg_literal->used_clauses[index]->is_subsumed ) {
-                var->neg_literal->used_clauses[index]->is_subsumed = 0;
+                subsumed = 0;
                 for( vi = 0; vi < var->neg_literal->used_clauses[index]->elements_size; ++vi )
                     if( asserted_literal(var->neg_literal->used_clauses[index]->elements[vi]) )
-                        var->neg_literal->used_clauses[index]->is_subsumed = 1;
+                        subsumed = 1;
+                set_subsumed(var->neg_literal->used_clauses[index], subsumed, sat_state);
                 mark_check_clause(var->neg_literal->used_clauses[index], sat_state);
             }
         }
@@ -408,21 +441,13 @@ Clause** resize_clause_list(Clause** original, c2dSize original_start, c2dSize o
     return expand;
 }
 
-//adds clause to the set of learned clauses, and runs unit resolution
-//returns a learned clause if unit resolution finds a contradiction, NULL otherwise
-//
-//this function is called on a clause returned by sat_decide_literal() or sat_assert_clause()
-//moreover, it should be called only if sat_at_assertion_level() succeeds
-Clause* sat_assert_clause(Clause* clause, SatState* sat_state) {
+// adds a clause (learned or not) to the clauses of sat state and to the lists of its literals and variables
+static void add_clause(Clause* clause, SatState* sat_state) {
     unsigned long index;
     Var* var;
     Lit* lit;
     
-    if( sat_state == NULL || clause == NULL ) {
-        return 0;
-    }
-    
-    clause->index = sat_state->clauses_size;
+    clause->index = sat_state->clauses_size + 1; // indices start at 1 (see sat_index2clause)
     clause->watch_1 = clause->elements[0];
     clause->watch_2 = clause->elements[0];
     clause->needs_checking = 0;
@@ -456,10 +481,29 @@ Clause* sat_assert_clause(Clause* clause, SatState* sat_state) {
             ? ( sat_state->clauses_to_check_end - sat_state->clauses_to_check_start )
             : ( sat_state->clauses_to_check_end + ( sat_state->clauses_capacity - sat_state->clauses_to_check_start ) );
         sat_state->clauses_to_check_start = 0;
+        
+        unsigned long *bits = new_bitset( sat_state->clauses_capacity * 2 );
+        memcpy(bits, sat_state->subsumed_bits, ( sat_state->clauses_capacity / SAT_WORD_BITS + 1 ) * sizeof(unsigned long));
+        free(sat_state->subsumed_bits);
+        sat_state->subsumed_bits = bits;
         sat_state->clauses_capacity *= 2;
     }
     sat_state->clauses[ sat_state->clauses_size ] = clause;
     ++sat_state->clauses_size;
+}
+
+//adds clause to the set of learned clauses, and runs unit resolution
+//returns a learned clause if unit resolution finds a contradiction, NULL otherwise
+//
+//this function is called on a clause returned by sat_decide_literal() or sat_assert_clause()
+//moreover, it should be called only if sat_at_assertion_level() succeeds
+Clause* sat_assert_clause(Clause* clause, SatState* sat_state) {
+    
+    if( sat_state == NULL || clause == NULL ) {
+        return 0;
+    }
+    
+    add_clause(clause, sat_state);
 
     ++sat_state->assertion_clause_count;
     if( clause == sat_state->assertion_clause )
@@ -473,6 +517,125 @@ Clause* sat_assert_clause(Clause* clause, SatState* sat_state) {
     return  NULL;
 }
 
+// adds a learned clause, given by the indices of its literals, to be checked by the next unit resolution
+static void add_learned_clause(const c2dLiteral* literals, c2dSize size, c2dSize lbd, SatState* sat_state) {
+    
+    Clause *clause = malloc(sizeof(Clause));
+    clause->elements = malloc( size * sizeof(Lit*) );
+    clause->elements_size = size;
+    for( c2dSize index = 0; index < size; ++index )
+        clause->elements[index] = sat_index2literal( literals[index], sat_state );
+    clause->assertion_level = 1;
+    clause->lbd = lbd;
+    clause->was_generated = 1;
+    
+    add_clause(clause, sat_state);
+    ++sat_state->assertion_clause_count;
+    mark_check_clause(clause, sat_state);
+}
+
+//adds a clause, given by the indices of its literals, to the set of learned clauses 
+//(e.g., a clause learned by an earlier run on the same cnf). the clause must be implied 
+//by the cnf, and no literal may be decided: it is checked by the next unit resolution
+void sat_add_learned_clause(const c2dLiteral* literals, c2dSize size, SatState* sat_state) {
+    if( sat_state == NULL || size == 0 )
+        return;
+    add_learned_clause(literals, size, size, sat_state);
+}
+
+/******************************************************************************
+ * Learned clause files:
+ * --A line "p learned F M", where F is a fingerprint of the cnf (in hex) and M is
+ * the number of clauses, followed by a line "D l_1 ... l_k 0" per clause, where
+ * D is its literal block distance and l_i are the indices of its literals
+ * --Learned clauses are implied by the cnf, so adding those saved by an earlier
+ * run on the same cnf (possibly with other decisions) does not change its models
+ ******************************************************************************/
+
+// returns a fingerprint of the variable count and clauses of the cnf of sat state
+static unsigned long cnf_fingerprint(const SatState* sat_state) {
+    unsigned long hashcode = sat_state->variables_size;
+    
+    for( c2dSize index = 0; index < sat_clause_count(sat_state); ++index ) {
+        Clause *clause = sat_state->clauses[index];
+        for( c2dSize i = 0; i < clause->elements_size; ++i ) {
+            hashcode = ( hashcode ^ (unsigned long)clause->elements[i]->index ) * 0x9E3779B97F4A7C15UL;
+            hashcode ^= hashcode >> 32;
+        }
+        hashcode *= 0x9E3779B97F4A7C15UL; // end of clause
+    }
+    return hashcode;
+}
+
+static BOOLEAN saved_learned_clause(const Clause* clause, c2dSize max_size, c2dSize max_lbd) {
+    return ( max_size == 0 || clause->elements_size <= max_size ) && ( max_lbd == 0 || clause->lbd <= max_lbd );
+}
+
+//saves the learned clauses of sat state with at most max_size literals and a literal block
+//distance of at most max_lbd to a file (0 for no limit), and sets their count
+//returns 0 if the file cannot be written
+BOOLEAN sat_save_learned_clauses(const char* fname, c2dSize max_size, c2dSize max_lbd, c2dSize* count, const SatState* sat_state) {
+    c2dSize index, i;
+    
+    *count = 0;
+    for( index = sat_clause_count(sat_state); index < sat_state->clauses_size; ++index )
+        if( saved_learned_clause(sat_state->clauses[index], max_size, max_lbd) )
+            ++*count;
+    
+    FILE *fp = fopen(fname, "w");
+    if( fp == NULL )
+        return 0;
+    
+    fprintf(fp, "p learned %016lx %lu\n", cnf_fingerprint(sat_state), *count);
+    for( index = sat_clause_count(sat_state); index < sat_state->clauses_size; ++index ) {
+        Clause *clause = sat_state->clauses[index];
+        if( !saved_learned_clause(clause, max_size, max_lbd) )
+            continue;
+        fprintf(fp, "%lu", clause->lbd);
+        for( i = 0; i < clause->elements_size; ++i )
+            fprintf(fp, " %ld", clause->elements[i]->index);
+        fprintf(fp, " 0\n");
+    }
+    return fclose(fp) == 0;
+}
+
+//adds the learned clauses saved in a file by sat_save_learned_clauses() to sat state, and sets
+//their count (0 if the file does not exist). no literal may be decided
+//returns 0 if the file was saved for another cnf (it is then ignored)
+BOOLEAN sat_load_learned_clauses(const char* fname, c2dSize* count, SatState* sat_state) {
+    unsigned long fingerprint;
+    c2dSize saved_count, index, size, lbd;
+    c2dLiteral literal;
+    
+    *count = 0;
+    FILE *fp = fopen(fname, "r");
+    if( fp == NULL )
+        return 1;
+    if( fscanf(fp, " p learned %lx %lu", &fingerprint, &saved_count) != 2 || fingerprint != cnf_fingerprint(sat_state) ) {
+        fclose(fp);
+        return 0;
+    }
+    
+    c2dLiteral *literals = malloc( ( sat_state->variables_size + 1 ) * sizeof(c2dLiteral) );
+    BOOLEAN ok = 1;
+    for( index = 0; ok && index < saved_count; ++index ) {
+        ok = fscanf(fp, "%lu", &lbd) == 1;
+        for( size = 0; ok; ++size ) {
+            ok = fscanf(fp, "%ld", &literal) == 1 && size <= sat_state->variables_size && (c2dSize)labs(literal) <= sat_state->variables_size;
+            if( !ok || literal == 0 )
+                break;
+            literals[size] = literal;
+        }
+        if( ok && size > 0 ) {
+            add_learned_clause(literals, size, lbd, sat_state);
+            ++*count;
+        }
+    }
+    free(literals);
+    fclose(fp);
+    return 1;
+}
+
 /******************************************************************************
  * A SatState should keep track of pretty much everything you will need to
  * condition/uncondition variables, perform unit resolution, and do clause learning
@@ -589,10 +752,13 @@ SatState* sat_state_new(const char* cnf_fname) {
             ret->clauses_to_check = (Clause**) malloc( ret->clauses_capacity * sizeof(Clause*) );
             ret->clauses_to_check_start = 0;
             ret->clauses_to_check_end   = 0;
+            ret->subsumed_bits    = new_bitset( ret->clauses_capacity );
+            ret->implied_bits     = new_bitset( 2 * ret->variables_size + 1 );
             for(int i = 0; i < ret->clauses_size ; i++) {
                 ret->clauses[i] = (Clause*)malloc(sizeof(Clause));
                 ret->clauses[i]->is_subsumed   = 0;
                 ret->clauses[i]->was_generated = 0;
+                ret->clauses[i]->lbd           = 0;
             }
             
             ret->decisions    = (Lit**) malloc( ret->variables_size * sizeof(Lit*) );
@@ -695,6 +861,8 @@ void sat_state_free(SatState* sat_state) {
     }
     free(sat_state->clauses);
     free(sat_state->clauses_to_check);
+    free(sat_state->subsumed_bits);
+    free(sat_state->implied_bits);
     
     for( index = 0; index < sat_state->variables_size; ++index ) {
         free(sat_state->variables[index]->pos_literal->used_clauses);
@@ -815,22 +983,30 @@ void generate_assertion_clause(Clause *conflict_clause, SatState *sat_state) {
     }
 
     // build the assertion clause itself, while simultaneously calculating the assertion level
+    // and the literal block distance (the number of distinct decision levels of its literals)
     clause = malloc(sizeof(Clause));
     clause->elements = malloc( real_list_size * sizeof(Lit*) );
     clause->elements_size = real_list_size;
     
+    BOOLEAN *levels = calloc( decision_level + 1, sizeof(BOOLEAN) );
     i = 0;
     assertion_level = 1;
+    clause->lbd = 0;
     for( index = 0; index < list_size; ++index ) {
         if( list[index]->var_ptr->assertion_use ) {
             clause->elements[i++] = list[index];
             if( list[index]->var_ptr->decision_level < decision_level && list[index]->var_ptr->decision_level > assertion_level )
                 assertion_level = list[index]->var_ptr->decision_level;
+            if( !levels[ list[index]->var_ptr->decision_level ] ) {
+                levels[ list[index]->var_ptr->decision_level ] = 1;
+                ++clause->lbd;
+            }
         }
         list[index]->var_ptr->assertion_use  = 0;
         list[index]->var_ptr->assertion_list = 0;
     }
     
+    free(levels);
     free(list);
     
     clause->assertion_level = assertion_level;
@@ -857,7 +1033,7 @@ BOOLEAN check_clause( Clause* clause, SatState *sat_state ) {
     found_lit_2 = 0;
     for( index = 0; index < clause->elements_size && !( found_lit_1 && found_lit_2 ); ++index ) {
         if( asserted_literal(clause->elements[index]) ) {
-            clause->is_subsumed = 1;
+            set_subsumed(clause, 1, sat_state);
             return 1;
         }
         if( !set_literal(clause->elements[index]) ) {
@@ -881,7 +1057,7 @@ BOOLEAN check_clause( Clause* clause, SatState *sat_state ) {
     }
     else if( found_lit_1 && !found_lit_2 ) {
         // if we have a new implication
-        clause->is_subsumed = 1;
+        set_subsumed(clause, 1, sat_state);
         imply_literal(lit_1, clause, sat_state);
     }
     else {
@@ -929,6 +1105,41 @@ BOOLEAN sat_at_assertion_level(const Clause* clause, const SatState* sat_state)
     return 0;
 }
 
+//sets the observers of a sat state (either can be NULL), which are passed data when called
+void sat_set_observers(SatClauseObserver clause_observer, SatLiteralObserver literal_observer, void* data, SatState* sat_state) {
+    
+    if( sat_state == NULL )
+        return;
+    sat_state->clause_observer  = clause_observer;
+    sat_state->literal_observer = literal_observer;
+    sat_state->observer_data    = data;
+}
+
+//returns the data passed to the observers of a sat state
+void* sat_observer_data(const SatState* sat_state) {
+    
+    if( sat_state != NULL )
+        return sat_state->observer_data;
+    return NULL;
+}
+
+//returns the packed subsumed flags of clauses (bit i for the clause with index i)
+const unsigned long* sat_subsumed_bits(const SatState* sat_state) {
+    
+    if( sat_state != NULL )
+        return sat_state->subsumed_bits;
+    return NULL;
+}
+
+//returns the packed implied flags of literals (bits 2i and 2i+1 for the positive
+//and negative literals of the variable with index i)
+const unsigned long* sat_implied_bits(const SatState* sat_state) {
+    
+    if( sat_state != NULL )
+        return sat_state->implied_bits;
+    return NULL;
+}
+
 /******************************************************************************
  * The functions below are already implemented for you and MUST STAY AS IS
  ******************************************************************************/
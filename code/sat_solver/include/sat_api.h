@@ -66,6 +66,8 @@ BOOLEAN sat_subsumed_clause(const Clause* clause);
 c2dSize sat_clause_count(const SatState* sat_state);
 c2dSize sat_learned_clause_count(const SatState* sat_state);
 Clause* sat_assert_clause(Clause* clause, SatState* sat_state);
+BOOLEAN sat_save_learned_clauses(const char* fname, c2dSize max_size, c2dSize max_lbd, c2dSize* count, const SatState* sat_state);
+BOOLEAN sat_load_learned_clauses(const char* fname, c2dSize* count, SatState* sat_state);
 BOOLEAN sat_marked_clause(const Clause* clause);
 void sat_mark_clause(Clause* clause);
 void sat_unmark_clause(Clause* clause);
@@ -48,19 +48,40 @@ BOOLEAN sat(SatState* sat_state) {
 
 
 int main(int argc, char* argv[]) {	
-  char USAGE_MSG[] = "Usage: ./sat -c <cnf_file>\n";
-  char* cnf_fname  = NULL;
+  char USAGE_MSG[] = "Usage: ./sat -c <cnf_file> [-l <learned_file> [-s <max_size>] [-b <max_lbd>]]\n"
+                     "  -l: add the learned clauses saved in <learned_file> by a run on the same cnf (if any),\n"
+                     "      and save the learned clauses to <learned_file>\n"
+                     "  -s: only save learned clauses with at most <max_size> literals\n"
+                     "  -b: only save learned clauses with a literal block distance of at most <max_lbd>\n";
+  char* cnf_fname     = NULL;
+  char* learned_fname = NULL;
+  c2dSize max_size = 0, max_lbd = 0; //no limit
 
-  if(argc==3 && strcmp("-c",argv[1])==0) cnf_fname = argv[2];
-  else {
+  BOOLEAN ok = argc%2==1; //options come with arguments
+  for(int i=1; ok && i<argc; i+=2) {
+    if(strcmp("-c",argv[i])==0) cnf_fname = argv[i+1];
+    else if(strcmp("-l",argv[i])==0) learned_fname = argv[i+1];
+    else if(strcmp("-s",argv[i])==0) max_size = strtoul(argv[i+1],NULL,10);
+    else if(strcmp("-b",argv[i])==0) max_lbd  = strtoul(argv[i+1],NULL,10);
+    else ok = 0;
+  }
+  if(!ok || cnf_fname==NULL) {
     printf("%s",USAGE_MSG);
     exit(1);
   }
 
   //construct a sat state and then check satisfiability
   SatState* sat_state = sat_state_new(cnf_fname);
+  c2dSize count;
+  if(learned_fname!=NULL && !sat_load_learned_clauses(learned_fname,&count,sat_state)) {
+    printf("Ignoring %s (saved for another cnf)\n",learned_fname);
+  }
   if(sat(sat_state)) printf("SAT\n");
   else printf("UNSAT\n");
+  if(learned_fname!=NULL && !sat_save_learned_clauses(learned_fname,max_size,max_lbd,&count,sat_state)) {
+    printf("Cannot write %s\n",learned_fname);
+    exit(1);
+  }
   sat_state_free(sat_state);
 
   return 0;